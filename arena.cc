@@ -0,0 +1,88 @@
+#include "arena.h"
+#include <cstdint>
+#include <cstdlib>
+
+arena::arena(size_t chunk)
+        : _chunk {chunk}
+{
+}
+
+arena::~arena(void)
+{
+        while (_head != nullptr) {
+                auto next = _head->next;
+                free(_head);
+                _head = next;
+        }
+}
+
+static char *align_up(char *p, size_t align)
+{
+        auto u = reinterpret_cast<uintptr_t>(p);
+        return reinterpret_cast<char *>((u + align - 1) & ~(align - 1));
+}
+
+void *arena::alloc(size_t n, size_t align)
+{
+        auto p = align_up(_ptr, align);
+        if (_ptr == nullptr || p > _end || static_cast<size_t>(_end - p) < n) {
+                if (!grow(n, align))
+                        throw std::bad_alloc{};
+                p = align_up(_ptr, align);
+        }
+
+        _ptr = p + n;
+        _stats.allocs++;
+        _stats.bytes += n;
+        return p;
+}
+
+/*
+ * move on to the next kept chunk if it is big enough, otherwise
+ * take a new one from the heap and link it in after the current.
+ */
+bool arena::grow(size_t n, size_t align)
+{
+        auto need = n + align;
+        if (_cur != nullptr && _cur->next != nullptr &&
+                        _cur->next->size >= need) {
+                _cur = _cur->next;
+        } else {
+                auto size = need > _chunk ? need : _chunk;
+                auto c = static_cast<chunk *>(malloc(sizeof(chunk) + size));
+                if (c == nullptr)
+                        return false;
+                c->size = size;
+                if (_cur == nullptr) {
+                        c->next = _head;
+                        _head = c;
+                } else {
+                        c->next = _cur->next;
+                        _cur->next = c;
+                }
+                _cur = c;
+                _stats.mallocs++;
+        }
+
+        _ptr = reinterpret_cast<char *>(_cur + 1);
+        _end = _ptr + _cur->size;
+        return true;
+}
+
+/*
+ * forget everything handed out. O(1): chunks stay linked and are
+ * refilled from the first one on.
+ */
+void arena::reset(void)
+{
+        _cur = _head;
+        _ptr = _cur == nullptr ? nullptr : reinterpret_cast<char *>(_cur + 1);
+        _end = _cur == nullptr ? nullptr : _ptr + _cur->size;
+        _stats.allocs = 0;
+        _stats.bytes = 0;
+}
+
+const arena_stats& arena::stats(void) const
+{
+        return _stats;
+}
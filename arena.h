@@ -0,0 +1,90 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <new>
+
+struct arena_stats {
+        size_t allocs;  /* allocations served since the last reset */
+        size_t bytes;   /* bytes handed out since the last reset */
+        size_t mallocs; /* chunks ever taken from the heap */
+};
+
+/*
+ * bump allocator. memory is only given back all at once by reset(),
+ * which keeps every chunk for reuse, so once an arena has grown to
+ * fit its largest request it stops touching the heap.
+ */
+class arena {
+private:
+        struct chunk {
+                chunk *next;
+                size_t size;
+        };
+        chunk *_head {nullptr};
+        chunk *_cur {nullptr};
+        char *_ptr {nullptr};
+        char *_end {nullptr};
+        size_t _chunk {0};
+        arena_stats _stats {0, 0, 0};
+        bool grow(size_t n, size_t align);
+public:
+        arena(size_t chunk = 4096);
+        ~arena(void);
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+        void *alloc(size_t n, size_t align = alignof(std::max_align_t));
+        void reset(void);
+        const arena_stats& stats(void) const;
+};
+
+/*
+ * std allocator drawing from an arena. deallocate() is a no-op; the
+ * memory comes back on arena::reset(). with no arena it falls back
+ * to the heap.
+ */
+template <typename T>
+class arena_alloc {
+public:
+        typedef T value_type;
+        arena *_arena {nullptr};
+
+        arena_alloc(arena *a = nullptr) noexcept
+                : _arena {a}
+        {
+        }
+
+        template <typename U>
+        arena_alloc(const arena_alloc<U>& other) noexcept
+                : _arena {other._arena}
+        {
+        }
+
+        T *allocate(size_t n)
+        {
+                if (_arena == nullptr)
+                        return static_cast<T *>(::operator new(n * sizeof(T)));
+                return static_cast<T *>(_arena->alloc(n * sizeof(T),
+                        alignof(T)));
+        }
+
+        void deallocate(T *p, size_t) noexcept
+        {
+                if (_arena == nullptr)
+                        ::operator delete(p);
+        }
+};
+
+template <typename T, typename U>
+bool operator==(const arena_alloc<T>& a, const arena_alloc<U>& b)
+{
+        return a._arena == b._arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const arena_alloc<T>& a, const arena_alloc<U>& b)
+{
+        return a._arena != b._arena;
+}
+
+#endif
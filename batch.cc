@@ -0,0 +1,213 @@
+#include "batch.h"
+#include "scan.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * one piece of the input, cut at a request boundary. each keeps its
+ * own output so pieces can finish in any order.
+ */
+struct piece {
+        size_t off;
+        size_t len;
+        size_t requests;
+        char *out;
+        size_t outlen;
+        parse_error err;
+        bool ok;
+};
+
+/*
+ * a worker's queue of piece numbers. the owner pops from the back,
+ * thieves take from the front, so a thief gets the work its owner
+ * would have reached last.
+ */
+struct workq {
+        std::mutex lock;
+        std::deque<size_t> q;
+};
+
+static const size_t MIN_PIECE {64 * 1024};
+
+/*
+ * does a request line start at off? only the method is looked at:
+ * upper case letters and a space, which body bytes are unlikely to
+ * open with straight after a blank line.
+ */
+static bool reqline_at(const char *buf, size_t len, size_t off)
+{
+        size_t i = off;
+        while (i < len && i - off < 16 && buf[i] >= 'A' && buf[i] <= 'Z')
+                i++;
+        return i == len || (i != off && i < len && buf[i] == ' ');
+}
+
+/*
+ * end of the request that contains off: just past the next blank
+ * line that a request line follows. a body can hold blank lines of
+ * its own, which is why the next line is checked as well.
+ */
+size_t batch_boundary(const char *buf, size_t len, size_t off)
+{
+        while (off < len) {
+                auto cr = off + scan_byte(buf + off, len - off, '\r');
+                if (cr + 3 >= len)
+                        return len;
+                if (memcmp(buf + cr, "\r\n\r\n", 4) == 0 &&
+                    reqline_at(buf, len, cr + 4))
+                        return cr + 4;
+                off = cr + 1;
+        }
+        return len;
+}
+
+static std::vector<piece> split(const char *buf, size_t len, int threads)
+{
+        auto want = len / (static_cast<size_t>(threads) * 8);
+        if (want < MIN_PIECE)
+                want = MIN_PIECE;
+
+        std::vector<piece> pieces;
+        for (size_t off = 0; off < len; ) {
+                auto end = off + want >= len ? len :
+                        batch_boundary(buf, len, off + want);
+                pieces.push_back(piece{off, end - off, 0, nullptr, 0,
+                        parse_error{ERR_NONE, 0, TOK_EOF, TOK_EOF}, true});
+                off = end;
+        }
+        return pieces;
+}
+
+/*
+ * a worker's parser, built once and reset() between the pieces it
+ * runs so its buffer and arena are reused. pc and out are the piece
+ * being parsed and where its output goes.
+ */
+struct worker {
+        batch_fn& fn;
+        piece *pc;
+        FILE *out;
+        parser p;
+
+        worker(batch_fn& f, bool lazy)
+                : fn {f},
+                pc {nullptr},
+                out {nullptr},
+                p {[this](const request& req) { got(req); }, lazy}
+        {
+        }
+
+        void got(const request& req)
+        {
+                if (!pc->ok)
+                        return;
+                pc->requests++;
+                if (!fn(out, req)) {
+                        pc->err = p.error();
+                        pc->ok = false;
+                }
+        }
+
+        void run(const char *buf, piece& next, batch_end_fn& end);
+};
+
+void worker::run(const char *buf, piece& next, batch_end_fn& end)
+{
+        pc = &next;
+        out = open_memstream(&pc->out, &pc->outlen);
+        if (out == nullptr)
+                err(EX_OSERR, "open_memstream");
+
+        if (p.feed(buf + pc->off, pc->len) == PARSE_ERROR) {
+                pc->err = p.error();
+                pc->ok = false;
+        } else if (pc->ok && p.pending() != 0) {
+                pc->err = parse_error{ERR_TOKEN, pc->len, TOK_EOL, TOK_EOF};
+                pc->ok = false;
+        }
+        pc->err.off += pc->off;
+        p.reset();
+        if (end)
+                end(out);
+        fclose(out);
+}
+
+static bool take(std::vector<workq>& qs, size_t self, size_t *task,
+                std::atomic<size_t>& steals)
+{
+        {
+                std::lock_guard<std::mutex> g {qs[self].lock};
+                if (!qs[self].q.empty()) {
+                        *task = qs[self].q.back();
+                        qs[self].q.pop_back();
+                        return true;
+                }
+        }
+
+        for (size_t i = 1; i < qs.size(); i++) {
+                auto& victim = qs[(self + i) % qs.size()];
+                std::lock_guard<std::mutex> g {victim.lock};
+                if (!victim.q.empty()) {
+                        *task = victim.q.front();
+                        victim.q.pop_front();
+                        steals++;
+                        return true;
+                }
+        }
+        return false;
+}
+
+/*
+ * parse a capture of back-to-back requests on threads workers, one
+ * parser each, and write what fn produced to out in input order.
+ * false if some piece failed; err then holds the first error in the
+ * input with its offset from the start of buf.
+ */
+bool batch_parse(const char *buf, size_t len, int threads, bool lazy,
+                batch_fn fn, FILE *out, batch_stats *stats,
+                parse_error *err, batch_end_fn end)
+{
+        if (threads < 1)
+                threads = 1;
+
+        auto pieces = split(buf, len, threads);
+        std::vector<workq> qs(threads);
+        for (size_t i = 0; i < pieces.size(); i++)
+                qs[i * threads / pieces.size()].q.push_front(i);
+
+        std::atomic<size_t> steals {0};
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t] {
+                        worker w {fn, lazy};
+                        size_t i;
+                        while (take(qs, t, &i, steals))
+                                w.run(buf, pieces[i], end);
+                });
+        }
+        for (auto& w : workers)
+                w.join();
+
+        auto ok = true;
+        size_t requests = 0;
+        for (auto& pc : pieces) {
+                if (ok) {
+                        fwrite(pc.out, 1, pc.outlen, out);
+                        requests += pc.requests;
+                        if (!pc.ok) {
+                                *err = pc.err;
+                                ok = false;
+                        }
+                }
+                free(pc.out);
+        }
+
+        if (stats != nullptr)
+                *stats = batch_stats{requests, pieces.size(), steals};
+        return ok;
+}
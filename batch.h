@@ -0,0 +1,33 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "parser.h"
+#include <cstdio>
+#include <functional>
+
+/*
+ * called on a worker thread for every request in a piece. whatever
+ * it writes to out is emitted in input order once all pieces are
+ * done. returning false stops the piece with the parser's error.
+ */
+typedef std::function<bool(FILE *out, const request&)> batch_fn;
+
+/*
+ * called on the same thread once a piece is done, for output that
+ * fn held back, say to write it a block at a time.
+ */
+typedef std::function<void(FILE *out)> batch_end_fn;
+
+struct batch_stats {
+        size_t requests;
+        size_t pieces;
+        size_t steals;
+};
+
+size_t batch_boundary(const char *buf, size_t len, size_t off);
+
+bool batch_parse(const char *buf, size_t len, int threads, bool lazy,
+                batch_fn fn, FILE *out, batch_stats *stats,
+                parse_error *err, batch_end_fn end = nullptr);
+
+#endif
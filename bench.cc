@@ -0,0 +1,233 @@
+#include "mapfile.h"
+#include "parser.h"
+#include "scan.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * every heap allocation the process makes goes through here, so the
+ * numbers below include whatever the std containers do behind our
+ * back.
+ */
+static size_t heap_allocs;
+
+void *operator new(size_t n)
+{
+        heap_allocs++;
+        auto p = malloc(n == 0 ? 1 : n);
+        if (p == nullptr)
+                throw std::bad_alloc{};
+        return p;
+}
+
+void operator delete(void *p) noexcept
+{
+        free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+        free(p);
+}
+
+struct result {
+        size_t requests;
+        size_t tokens;
+        size_t allocs;
+        size_t arena_allocs;
+        double ns;
+};
+
+static const char *isa_names[] {"scalar", "sse2", "avx2"};
+
+static double now_ns(void)
+{
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(
+                steady_clock::now().time_since_epoch()).count();
+}
+
+struct head {
+        size_t off;
+        size_t len;
+};
+
+/*
+ * where each request's head is. found with a parse of the whole
+ * file in place, outside the timed runs, so the lexer run can step
+ * over bodies.
+ */
+static std::vector<head> heads(const mapped_file& in)
+{
+        std::vector<head> hs;
+        parser p {[&](const request& req) {
+                auto end = static_cast<const char *>(memmem(req.raw,
+                        in.data() + in.size() - req.raw, "\r\n\r\n", 4));
+                hs.push_back(head{static_cast<size_t>(req.raw - in.data()),
+                        static_cast<size_t>(end + 4 - req.raw)});
+        }};
+        if (p.feed(in.data(), in.size()) == PARSE_ERROR)
+                usage("byte %zu: %s", p.error().off,
+                    error_name(p.error().code));
+        return hs;
+}
+
+/*
+ * tokenize every head the way the parser would, a whole head per
+ * call, without building a request
+ */
+static result run_lexer(const mapped_file& in, const std::vector<head>& hs)
+{
+        result r {0, 0, 0, 0, 0};
+        lexer lex {nullptr, 0};
+        token toks[256];
+
+        auto allocs = heap_allocs;
+        auto start = now_ns();
+        for (const auto& h : hs) {
+                /* without the blank line, which would lex as a header */
+                lex.reset(in.data() + h.off, h.len - 2);
+                size_t n;
+                while ((n = lex.tokenize(toks, 256)) != 0) {
+                        if (lex.error().code != ERR_NONE)
+                                usage("byte %zu: %s",
+                                    h.off + lex.error().off,
+                                    error_name(lex.error().code));
+                        r.tokens += n;
+                        if (toks[n - 1].type() == TOK_EOF) {
+                                r.tokens--;
+                                break;
+                        }
+                }
+                r.requests++;
+        }
+        r.ns = now_ns() - start;
+        r.allocs = heap_allocs - allocs;
+        return r;
+}
+
+#ifdef PARSE_STATS
+/* every parser's figures, printed after the runs */
+static parse_stats snapshot;
+#endif
+
+static result run_parser(const mapped_file& in, size_t chunk, bool lazy)
+{
+        result r {0, 0, 0, 0, 0};
+        parser *pp = nullptr;
+        auto cb = [&r, &pp](const request&) {
+                r.requests++;
+                r.arena_allocs += pp->mem().allocs;
+        };
+
+        auto allocs = heap_allocs;
+        auto start = now_ns();
+        parser p {cb, lazy};
+        pp = &p;
+        for (size_t pos = 0; pos < in.size(); pos += chunk) {
+                auto n = in.size() - pos < chunk ? in.size() - pos : chunk;
+                if (p.feed(in.data() + pos, n) == PARSE_ERROR)
+                        usage("byte %zu: %s", p.error().off,
+                            error_name(p.error().code));
+        }
+        r.ns = now_ns() - start;
+        r.allocs = heap_allocs - allocs + p.mem().mallocs;
+#ifdef PARSE_STATS
+        snapshot.merge(p.stats());
+#endif
+        return r;
+}
+
+static void report(const char *mode, const mapped_file& in, size_t tokens,
+                int iters, const result& r)
+{
+        auto reqs = static_cast<double>(r.requests);
+        printf("{\"mode\":\"%s\",\"isa\":\"%s\",\"iterations\":%d,"
+                "\"requests\":%zu,\"bytes\":%zu,\"tokens\":%zu,"
+                "\"ns\":%.0f,\"req_per_s\":%.0f,\"ns_per_byte\":%.3f,"
+                "\"tokens_per_s\":%.0f,\"allocs_per_req\":%.4f,"
+                "\"arena_allocs_per_req\":%.2f}\n",
+                mode, isa_names[scan_isa()], iters,
+                r.requests / iters, in.size(), tokens,
+                r.ns / iters, reqs / r.ns * 1e9,
+                r.ns / (static_cast<double>(in.size()) * iters),
+                static_cast<double>(tokens) * iters / r.ns * 1e9,
+                r.allocs / reqs, r.arena_allocs / reqs);
+}
+
+static void add(result& sum, const result& r)
+{
+        sum.requests += r.requests;
+        sum.tokens += r.tokens;
+        sum.allocs += r.allocs;
+        sum.arena_allocs += r.arena_allocs;
+        sum.ns += r.ns;
+}
+
+int main(int argc, char **argv)
+{
+        const char *mode = "all";
+        auto iters = 20;
+        size_t chunk = 4096;
+        int c;
+
+        while ((c = getopt(argc, argv, "m:n:c:i:")) != -1) {
+                switch (c) {
+                case 'm':
+                        mode = optarg;
+                        break;
+                case 'n':
+                        iters = atoi(optarg);
+                        break;
+                case 'c':
+                        chunk = strtoul(optarg, nullptr, 10);
+                        break;
+                case 'i':
+                        for (int i = SCAN_SCALAR; i <= SCAN_AVX2; i++) {
+                                if (strcmp(optarg, isa_names[i]) == 0)
+                                        scan_select(i);
+                        }
+                        break;
+                default:
+                        usage("usage: %s [-m lexer|parse|lazy|all] "
+                            "[-n iterations] [-c chunk] "
+                            "[-i scalar|sse2|avx2] file", argv[0]);
+                }
+        }
+        if (optind != argc - 1 || iters <= 0 || chunk == 0)
+                usage("usage: %s [-m mode] [-n iterations] [-c chunk] "
+                    "[-i isa] file", argv[0]);
+
+        mapped_file in;
+        if (!in.open(argv[optind]))
+                err(EX_NOINPUT, "%s", argv[optind]);
+        auto hs = heads(in);
+        auto tokens = run_lexer(in, hs).tokens;
+        auto all = strcmp(mode, "all") == 0;
+
+        if (all || strcmp(mode, "lexer") == 0) {
+                result sum {0, 0, 0, 0, 0};
+                for (int i = 0; i < iters; i++)
+                        add(sum, run_lexer(in, hs));
+                report("lexer", in, tokens, iters, sum);
+        }
+
+        for (auto lazy : {false, true}) {
+                auto name = lazy ? "lazy" : "parse";
+                if (!all && strcmp(mode, name) != 0)
+                        continue;
+
+                run_parser(in, chunk, lazy);
+                result sum {0, 0, 0, 0, 0};
+                for (int i = 0; i < iters; i++)
+                        add(sum, run_parser(in, chunk, lazy));
+                report(name, in, tokens, iters, sum);
+        }
+#ifdef PARSE_STATS
+        snapshot.dump(stdout);
+#endif
+}
@@ -0,0 +1,59 @@
+#include "body.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * the pipe splice() goes through. one per thread, made on first use
+ * and kept, so forwarding costs no descriptors per request.
+ */
+struct relay {
+        int fd[2] {-1, -1};
+
+        ~relay(void)
+        {
+                if (fd[0] >= 0) {
+                        close(fd[0]);
+                        close(fd[1]);
+                }
+        }
+};
+
+static thread_local relay pipe_;
+
+static ssize_t drain(int to, size_t n)
+{
+        size_t done = 0;
+        while (done < n) {
+                auto m = splice(pipe_.fd[0], nullptr, to, nullptr, n - done,
+                        SPLICE_F_MOVE);
+                if (m < 0 && errno == EINTR)
+                        continue;
+                if (m <= 0)
+                        return -1;
+                done += m;
+        }
+        return done;
+}
+
+ssize_t forward(int from, int to, size_t n)
+{
+        struct stat st;
+        if (fstat(from, &st) < 0)
+                return -1;
+        if (S_ISREG(st.st_mode))
+                return sendfile(to, from, nullptr, n);
+
+        if (pipe_.fd[0] < 0 && pipe2(pipe_.fd, O_CLOEXEC) < 0)
+                return -1;
+
+        auto m = splice(from, nullptr, pipe_.fd[1], nullptr, n,
+                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (m <= 0)
+                return m;
+        if (drain(to, m) < 0)
+                return -1;
+        return m;
+}
@@ -0,0 +1,17 @@
+#ifndef BODY_H
+#define BODY_H
+
+#include <cstddef>
+#include <sys/types.h>
+
+/*
+ * move up to n body bytes from one descriptor to another without
+ * them passing through user space: sendfile() when from is a regular
+ * file, splice() through a pipe otherwise. returns how many moved,
+ * or -1 with errno set, EAGAIN meaning from had nothing ready. to
+ * is written until it has taken everything read, so it should be a
+ * file or a blocking descriptor.
+ */
+ssize_t forward(int from, int to, size_t n);
+
+#endif
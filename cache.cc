@@ -0,0 +1,173 @@
+#include "cache.h"
+#include <chrono>
+#include <functional>
+
+uint64_t cache_clock(void)
+{
+        auto t = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::seconds>(t).count();
+}
+
+/* cap is split evenly between the shards */
+response_cache::response_cache(size_t shards, size_t cap)
+        : _shards(shards == 0 ? 1 : shards),
+        _cap {cap / _shards.size()}
+{
+        for (auto& s : _shards)
+                s.bytes = 0;
+}
+
+response_cache::shard& response_cache::pick(const std::string& key)
+{
+        return _shards[std::hash<std::string>{}(key) % _shards.size()];
+}
+
+static bool cacheable(const request& req)
+{
+        switch (req.verb) {
+        case METHOD_GET:
+        case METHOD_HEAD:
+                return true;
+        default:
+                return false;
+        }
+}
+
+/*
+ * method, path and query. the key is reused per thread so that a
+ * lookup doesn't allocate.
+ */
+static const std::string& key(const char *method, const request& req)
+{
+        thread_local std::string k;
+        k.assign(method);
+        k += ' ';
+        k.append(req.path.data(), req.path.size());
+        if (req.query.len != 0) {
+                k += '?';
+                k.append(req.raw + req.query.off, req.query.len);
+        }
+        return k;
+}
+
+/* drop least recently used responses until need more bytes fit */
+void response_cache::evict(shard& s, size_t need)
+{
+        while (!s.lru.empty() && s.bytes + need > _cap) {
+                auto it = s.map.find(*s.lru.back());
+                s.bytes -= it->second.resp->response.size();
+                s.lru.pop_back();
+                s.map.erase(it);
+        }
+}
+
+void response_cache::erase(const std::string& k)
+{
+        auto& s = pick(k);
+        std::lock_guard<std::mutex> g {s.lock};
+        auto it = s.map.find(k);
+        if (it == s.map.end())
+                return;
+        s.bytes -= it->second.resp->response.size();
+        s.lru.erase(it->second.age);
+        s.map.erase(it);
+}
+
+/*
+ * out is set whenever something is stored for the request, so that
+ * a revalidation has the old response to go by.
+ */
+int response_cache::lookup(const request& req, cached_ptr *out, uint64_t now)
+{
+        const auto& cc = req.cache;
+        auto parsed = req.load(TOK_CACHE_CONTROL);
+        out->reset();
+        if (!cacheable(req)) {
+                /* a POST or the like may change what GET would get */
+                erase(key("GET", req));
+                erase(key("HEAD", req));
+                _misses++;
+                return CACHE_MISS;
+        }
+        if (!parsed || cc.has(CC_NO_STORE)) {
+                _misses++;
+                return CACHE_MISS;
+        }
+
+        const auto& k = key(req.method.c_str(), req);
+        auto& s = pick(k);
+        {
+                std::lock_guard<std::mutex> g {s.lock};
+                auto it = s.map.find(k);
+                if (it != s.map.end()) {
+                        s.lru.splice(s.lru.begin(), s.lru, it->second.age);
+                        *out = it->second.resp;
+                }
+        }
+        if (*out == nullptr) {
+                _misses++;
+                return cc.has(CC_ONLY_IF_CACHED) ? CACHE_UNAVAILABLE :
+                        CACHE_MISS;
+        }
+
+        auto age = now > (*out)->stored ? now - (*out)->stored : 0;
+        uint64_t life = (*out)->max_age;
+        if (cc.has(CC_MAX_AGE) && cc.max_age < life)
+                life = cc.max_age;
+        auto ok = age < life;
+        if (ok && cc.has(CC_MIN_FRESH))
+                ok = life - age >= cc.min_fresh;
+        if (!ok && cc.has(CC_MAX_STALE))
+                ok = age <= life + cc.max_stale;
+
+        /* with only-if-cached, revalidating isn't an option */
+        if (ok && (!cc.has(CC_NO_CACHE) || cc.has(CC_ONLY_IF_CACHED))) {
+                _hits++;
+                return CACHE_HIT;
+        }
+        _misses++;
+        return cc.has(CC_ONLY_IF_CACHED) ? CACHE_UNAVAILABLE :
+                CACHE_REVALIDATE;
+}
+
+/*
+ * keep a response for max_age seconds. false if the request forbids
+ * storing it, it can't be cached or it is bigger than a shard.
+ */
+bool response_cache::store(const request& req, std::string response,
+                uint32_t max_age, uint64_t now)
+{
+        if (!cacheable(req) || !req.load(TOK_CACHE_CONTROL) ||
+            req.cache.has(CC_NO_STORE) || max_age == 0 ||
+            response.size() > _cap)
+                return false;
+
+        auto resp = std::make_shared<const cached>(cached{
+                std::move(response), now, max_age});
+        const auto& k = key(req.method.c_str(), req);
+        auto& s = pick(k);
+        std::lock_guard<std::mutex> g {s.lock};
+        auto it = s.map.find(k);
+        if (it != s.map.end()) {
+                s.bytes -= it->second.resp->response.size();
+                s.lru.erase(it->second.age);
+                s.map.erase(it);
+        }
+        evict(s, resp->response.size());
+
+        s.bytes += resp->response.size();
+        auto ins = s.map.emplace(k, slot{std::move(resp), s.lru.end()});
+        s.lru.push_front(&ins.first->first);
+        ins.first->second.age = s.lru.begin();
+        return true;
+}
+
+uint64_t response_cache::hits(void) const
+{
+        return _hits;
+}
+
+uint64_t response_cache::misses(void) const
+{
+        return _misses;
+}
@@ -0,0 +1,83 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "request.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum {
+        CACHE_MISS,             /* ask the backend; store() the answer */
+        CACHE_HIT,              /* the stored response will do */
+        CACHE_REVALIDATE,       /* stored, but check it with the backend */
+        CACHE_UNAVAILABLE,      /* only-if-cached and nothing fit: 504 */
+};
+
+/*
+ * a stored response, head and body as they go on the wire. shared so
+ * that one can be sent while another thread replaces it.
+ */
+struct cached {
+        std::string response;
+        uint64_t stored;        /* when, by cache_clock() */
+        uint32_t max_age;       /* seconds it stays fresh */
+};
+
+typedef std::shared_ptr<const cached> cached_ptr;
+
+uint64_t cache_clock(void);
+
+/*
+ * responses kept in memory keyed on method and target, split into
+ * shards by key, each with its own lock and LRU bounded in bytes, so
+ * threads serving different paths rarely wait on each other.
+ *
+ * lookup() decides from the request's Cache-Control. with no-store
+ * the cache is left out and store() refuses the answer; no-cache
+ * asks for whatever is stored to be revalidated. max-age lowers how
+ * long a response counts as fresh, min-fresh asks it to stay fresh
+ * a while longer, and max-stale lets it be stale by so much. what is
+ * stored but not fresh enough comes back for revalidation, unless
+ * only-if-cached rules out going to the backend. only GET and HEAD
+ * are answered; any other method drops what is stored for its
+ * target. a Cache-Control that doesn't parse keeps the request away
+ * from the cache altogether.
+ *
+ * times are in seconds, by default from cache_clock().
+ */
+class response_cache {
+private:
+        struct slot {
+                cached_ptr resp;
+                std::list<const std::string *>::iterator age;
+        };
+        struct shard {
+                std::mutex lock;
+                std::unordered_map<std::string, slot> map;
+                std::list<const std::string *> lru;
+                size_t bytes;
+        };
+        std::vector<shard> _shards;
+        size_t _cap;
+        std::atomic<uint64_t> _hits {0};
+        std::atomic<uint64_t> _misses {0};
+        shard& pick(const std::string& key);
+        void evict(shard& s, size_t need);
+        void erase(const std::string& key);
+public:
+        response_cache(size_t shards = 16, size_t cap = size_t{64} << 20);
+        int lookup(const request& req, cached_ptr *out,
+                uint64_t now = cache_clock());
+        bool store(const request& req, std::string response,
+                uint32_t max_age, uint64_t now = cache_clock());
+        uint64_t hits(void) const;
+        uint64_t misses(void) const;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "column.h"
+#include "error.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * summarise a columnar capture (main -b): how many requests, and how
+ * often each method, header name and Accept media type shows up,
+ * straight from the columns without parsing anything again.
+ */
+typedef std::unordered_map<std::string, uint64_t> tally;
+
+static void count(tally& t, span s)
+{
+        t[s.str()]++;
+}
+
+/* the JSON string characters that need escaping are rare here */
+static void print_string(const std::string& s)
+{
+        putchar('"');
+        for (auto c : s) {
+                if (c == '"' || c == '\\')
+                        putchar('\\');
+                if (static_cast<unsigned char>(c) < 0x20)
+                        printf("\\u%04x", c);
+                else
+                        putchar(c);
+        }
+        putchar('"');
+}
+
+static void print_tally(const char *name, const tally& t)
+{
+        std::vector<std::pair<std::string, uint64_t>> v(t.begin(), t.end());
+        std::sort(v.begin(), v.end(), [](const std::pair<std::string,
+                        uint64_t>& a, const std::pair<std::string,
+                        uint64_t>& b) {
+                return a.second != b.second ? a.second > b.second :
+                        a.first < b.first;
+        });
+
+        printf(",\"%s\":{", name);
+        for (size_t i = 0; i < v.size(); i++) {
+                if (i != 0)
+                        putchar(',');
+                print_string(v[i].first);
+                printf(":%" PRIu64, v[i].second);
+        }
+        putchar('}');
+}
+
+int main(int argc, char **argv)
+{
+        if (argc > 2)
+                usage("usage: %s [file]", argv[0]);
+        auto fp = argc == 2 ? fopen(argv[1], "rb") : stdin;
+        if (fp == nullptr)
+                err(EX_NOINPUT, "%s", argv[1]);
+
+        column_reader r {fp};
+        uint64_t blocks = 0;
+        uint64_t requests = 0;
+        uint64_t body = 0;
+        tally methods, headers, accepts;
+        while (r.next()) {
+                blocks++;
+                requests += r.rows();
+                for (size_t row = 0; row < r.rows(); row++) {
+                        count(methods, r.method(row));
+                        body += r.length(row);
+                        for (size_t i = 0; i < r.fields(row); i++)
+                                count(headers,
+                                        r.string(r.field_name(row, i)));
+                        for (size_t i = 0; i < r.accepts(row); i++)
+                                count(accepts,
+                                        r.string(r.accept_type(row, i)));
+                }
+        }
+        if (r.bad() || ferror(fp))
+                usage("%s: not a columnar file", argc == 2 ? argv[1] :
+                        "stdin");
+
+        printf("{\"blocks\":%" PRIu64 ",\"requests\":%" PRIu64
+                ",\"body_bytes\":%" PRIu64, blocks, requests, body);
+        print_tally("methods", methods);
+        print_tally("headers", headers);
+        print_tally("accept", accepts);
+        printf("}\n");
+}
@@ -0,0 +1,369 @@
+#include "column.h"
+#include "header.h"
+#include "names.h"
+#include "parser.h"
+#include <cstring>
+
+static uint32_t hash(const char *p, size_t n)
+{
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < n; i++)
+                h = (h ^ static_cast<unsigned char>(p[i])) * 16777619u;
+        return h;
+}
+
+/*
+ * double the slots, keeping them at most half full. an empty slot
+ * has an id past the last string.
+ */
+void string_dict::grow(void)
+{
+        std::vector<slot> old;
+        old.swap(_slots);
+        _slots.assign(old.empty() ? 256 : old.size() * 2,
+                slot{0, UINT32_MAX});
+        auto mask = _slots.size() - 1;
+        for (const auto& s : old) {
+                if (s.id == UINT32_MAX)
+                        continue;
+                auto i = s.hash & mask;
+                while (_slots[i].id != UINT32_MAX)
+                        i = (i + 1) & mask;
+                _slots[i] = s;
+        }
+}
+
+uint32_t string_dict::id(const char *p, size_t n)
+{
+        if (_slots.empty())
+                grow();
+
+        auto h = hash(p, n);
+        auto mask = _slots.size() - 1;
+        auto i = h & mask;
+        for (; _slots[i].id != UINT32_MAX; i = (i + 1) & mask) {
+                auto& s = _slots[i];
+                auto start = s.id == 0 ? 0 : _ends[s.id - 1];
+                if (s.hash == h && _ends[s.id] - start == n &&
+                    memcmp(_pool.data() + start, p, n) == 0)
+                        return s.id;
+        }
+
+        uint32_t id = _ends.size();
+        _pool.append(p, n);
+        _ends.push_back(_pool.size());
+        _slots[i] = slot{h, id};
+        if (_ends.size() * 2 > _slots.size())
+                grow();
+        return id;
+}
+
+size_t string_dict::size(void) const
+{
+        return _ends.size();
+}
+
+const std::string& string_dict::pool(void) const
+{
+        return _pool;
+}
+
+const std::vector<uint32_t>& string_dict::ends(void) const
+{
+        return _ends;
+}
+
+void string_dict::clear(void)
+{
+        _slots.clear();
+        _ends.clear();
+        _pool.clear();
+}
+
+/*
+ * a header's name in lower case as a dictionary id. known and
+ * interned names are looked up once per block, since their field ids
+ * say which name they are; the rest each time.
+ */
+uint32_t column_writer::name(const request& req, const field& f)
+{
+        auto cached = f.id < _names.size() && _names[f.id] != 0;
+        if (cached)
+                return _names[f.id] - 1;
+
+        span s;
+        if (f.id < TOK_COUNT)
+                s = span{header_name(f.id), strlen(header_name(f.id))};
+        else if (f.id != FIELD_OTHER && req.src != nullptr)
+                s = req.src->names().name(f.id);
+        else
+                s = req.text(f.name);
+
+        _scratch.assign(s.data(), s.size());
+        for (auto& c : _scratch) {
+                if (c >= 'A' && c <= 'Z')
+                        c |= 0x20;
+        }
+        auto id = _dict.id(_scratch.data(), _scratch.size());
+        if (f.id == FIELD_OTHER)
+                return id;
+        if (f.id >= _names.size())
+                _names.resize(f.id + 1, 0);
+        _names[f.id] = id + 1;
+        return id;
+}
+
+/*
+ * one request as a row. false if a header it needs doesn't parse;
+ * the parser's error() says why.
+ */
+bool column_writer::add(FILE *fp, const request& req)
+{
+        if (!req.load(TOK_CONTENT_LENGTH) || !req.load(TOK_CACHE_CONTROL) ||
+            !req.load(TOK_ACCEPT))
+                return false;
+
+        /* interned ids only mean something to the parser that gave them */
+        if (req.src != _src) {
+                _names.clear();
+                _src = req.src;
+        }
+
+        _method.push_back(_dict.id(req.method.data(), req.method.size()));
+        _path.push_back(_dict.id(req.path.data(), req.path.size()));
+        _major.push_back(req.major);
+        _minor.push_back(req.minor);
+        _length.push_back(req.len);
+        _seen.push_back(req.seen);
+        _cache.push_back(req.cache.dirs);
+        _max_age.push_back(req.cache.max_age);
+
+        for (const auto& f : req.fields)
+                _field_name.push_back(name(req, f));
+        _field_end.push_back(_field_name.size());
+
+        for (const auto& m : req.accept) {
+                _scratch.assign(m.type.data(), m.type.size());
+                _scratch += '/';
+                _scratch.append(m.subtype.data(), m.subtype.size());
+                _accept_type.push_back(_dict.id(_scratch.data(),
+                        _scratch.size()));
+                _accept_q.push_back(m.q);
+        }
+        _accept_end.push_back(_accept_type.size());
+
+        if (_method.size() == BLOCK)
+                return flush(fp);
+        return true;
+}
+
+template <typename T>
+static bool put(FILE *fp, const std::vector<T>& v)
+{
+        return v.empty() || fwrite(v.data(), sizeof(T), v.size(), fp) ==
+                v.size();
+}
+
+/*
+ * write the block gathered so far and start a new one. false if the
+ * write failed.
+ */
+bool column_writer::flush(FILE *fp)
+{
+        if (_method.empty())
+                return true;
+
+        std::vector<uint32_t> head {
+                COLUMN_MAGIC,
+                static_cast<uint32_t>(_method.size()),
+                static_cast<uint32_t>(_dict.size()),
+                static_cast<uint32_t>(_field_name.size()),
+                static_cast<uint32_t>(_accept_type.size()),
+                static_cast<uint32_t>(_dict.pool().size()),
+        };
+        auto ok = put(fp, head) && put(fp, _dict.ends()) &&
+                fwrite(_dict.pool().data(), 1, _dict.pool().size(), fp) ==
+                        _dict.pool().size() &&
+                put(fp, _method) && put(fp, _path) &&
+                put(fp, _major) && put(fp, _minor) &&
+                put(fp, _length) && put(fp, _seen) &&
+                put(fp, _cache) && put(fp, _max_age) &&
+                put(fp, _field_end) && put(fp, _field_name) &&
+                put(fp, _accept_end) && put(fp, _accept_type) &&
+                put(fp, _accept_q);
+
+        _dict.clear();
+        _names.clear();
+        for (auto v : {&_method, &_path, &_cache, &_max_age, &_field_end,
+                        &_field_name, &_accept_end, &_accept_type})
+                v->clear();
+        _major.clear();
+        _minor.clear();
+        _length.clear();
+        _seen.clear();
+        _accept_q.clear();
+        return ok;
+}
+
+size_t column_writer::rows(void) const
+{
+        return _method.size();
+}
+
+column_reader::column_reader(FILE *fp)
+        : _fp {fp}
+{
+}
+
+template <typename T>
+static bool get(FILE *fp, std::vector<T>& v, size_t n)
+{
+        v.resize(n);
+        return n == 0 || fread(v.data(), sizeof(T), n, fp) == n;
+}
+
+/*
+ * offsets within a block have to stay in bounds, or the accessors
+ * would read past the columns
+ */
+static bool ascending(const std::vector<uint32_t>& ends, size_t limit)
+{
+        uint32_t last = 0;
+        for (auto e : ends) {
+                if (e < last || e > limit)
+                        return false;
+                last = e;
+        }
+        return true;
+}
+
+/*
+ * load the next block. false at the end of the file, or when the
+ * block is cut short or malformed, which bad() tells apart.
+ */
+bool column_reader::next(void)
+{
+        _rows = 0;
+        std::vector<uint32_t> head;
+        if (!get(_fp, head, 6))
+                return false;
+        if (head[0] != COLUMN_MAGIC) {
+                _bad = true;
+                return false;
+        }
+
+        auto rows = head[1];
+        auto fields = head[3];
+        auto accepts = head[4];
+        _dict.resize(head[5]);
+        auto ok = get(_fp, _ends, head[2]) &&
+                fread(&_dict[0], 1, _dict.size(), _fp) == _dict.size() &&
+                get(_fp, _method, rows) && get(_fp, _path, rows) &&
+                get(_fp, _major, rows) && get(_fp, _minor, rows) &&
+                get(_fp, _length, rows) && get(_fp, _seen, rows) &&
+                get(_fp, _cache, rows) && get(_fp, _max_age, rows) &&
+                get(_fp, _field_end, rows) &&
+                get(_fp, _field_name, fields) &&
+                get(_fp, _accept_end, rows) &&
+                get(_fp, _accept_type, accepts) &&
+                get(_fp, _accept_q, accepts);
+        ok = ok && ascending(_ends, _dict.size()) &&
+                ascending(_field_end, fields) &&
+                ascending(_accept_end, accepts);
+        for (auto v : {&_method, &_path, &_field_name, &_accept_type}) {
+                for (auto id : *v)
+                        ok = ok && id < _ends.size();
+        }
+        if (!ok) {
+                _bad = true;
+                return false;
+        }
+        _rows = rows;
+        return true;
+}
+
+bool column_reader::bad(void) const
+{
+        return _bad;
+}
+
+size_t column_reader::rows(void) const
+{
+        return _rows;
+}
+
+size_t column_reader::strings(void) const
+{
+        return _ends.size();
+}
+
+span column_reader::string(uint32_t id) const
+{
+        auto start = id == 0 ? 0 : _ends[id - 1];
+        return span{_dict.data() + start, _ends[id] - start};
+}
+
+span column_reader::method(size_t row) const
+{
+        return string(_method[row]);
+}
+
+span column_reader::path(size_t row) const
+{
+        return string(_path[row]);
+}
+
+uint8_t column_reader::major(size_t row) const
+{
+        return _major[row];
+}
+
+uint8_t column_reader::minor(size_t row) const
+{
+        return _minor[row];
+}
+
+uint64_t column_reader::length(size_t row) const
+{
+        return _length[row];
+}
+
+uint64_t column_reader::seen(size_t row) const
+{
+        return _seen[row];
+}
+
+uint32_t column_reader::cache(size_t row) const
+{
+        return _cache[row];
+}
+
+uint32_t column_reader::max_age(size_t row) const
+{
+        return _max_age[row];
+}
+
+size_t column_reader::fields(size_t row) const
+{
+        return _field_end[row] - (row == 0 ? 0 : _field_end[row - 1]);
+}
+
+uint32_t column_reader::field_name(size_t row, size_t i) const
+{
+        return _field_name[(row == 0 ? 0 : _field_end[row - 1]) + i];
+}
+
+size_t column_reader::accepts(size_t row) const
+{
+        return _accept_end[row] - (row == 0 ? 0 : _accept_end[row - 1]);
+}
+
+uint32_t column_reader::accept_type(size_t row, size_t i) const
+{
+        return _accept_type[(row == 0 ? 0 : _accept_end[row - 1]) + i];
+}
+
+uint16_t column_reader::accept_q(size_t row, size_t i) const
+{
+        return _accept_q[(row == 0 ? 0 : _accept_end[row - 1]) + i];
+}
@@ -0,0 +1,141 @@
+#ifndef COLUMN_H
+#define COLUMN_H
+
+#include "request.h"
+#include "span.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * parsed requests in a columnar binary layout, for jobs that go over
+ * captures many times and would rather not parse them again.
+ *
+ * a file is a run of blocks of up to BLOCK requests. a block stands
+ * alone: it carries its own dictionary, so blocks written apart,
+ * by threads say, can simply be concatenated. all numbers are in
+ * host byte order.
+ *
+ *      u32 magic, rows, strings, fields, accepts
+ *      u32 dictionary bytes, then the end of each string in them
+ *      dictionary bytes
+ *      u32 method[rows], path[rows]            dictionary ids
+ *      u8  major[rows], minor[rows]
+ *      u64 length[rows]                        Content-Length
+ *      u64 seen[rows]                          known header bits
+ *      u32 cache[rows], max_age[rows]          Cache-Control
+ *      u32 field_end[rows]                     end of a row's fields
+ *      u32 field_name[fields]                  dictionary ids
+ *      u32 accept_end[rows]                    end of a row's Accept
+ *      u32 accept_type[accepts]                "type/subtype" ids
+ *      u16 accept_q[accepts]                   q in thousandths
+ *
+ * header names are lower case, so a name comes out the same however
+ * it was sent.
+ */
+
+static const uint32_t COLUMN_MAGIC {0x4c4f4348};        /* "HCOL" */
+
+/*
+ * strings to dictionary ids. a string already in it costs a hash and
+ * a compare; a new one is copied once into a shared pool.
+ */
+class string_dict {
+private:
+        struct slot {
+                uint32_t hash;
+                uint32_t id;
+        };
+        std::vector<slot> _slots {};
+        std::vector<uint32_t> _ends {};
+        std::string _pool {};
+        void grow(void);
+public:
+        uint32_t id(const char *p, size_t n);
+        size_t size(void) const;
+        const std::string& pool(void) const;
+        const std::vector<uint32_t>& ends(void) const;
+        void clear(void);
+};
+
+/*
+ * gathers requests into columns and writes them out a block at a
+ * time. add() flushes by itself when a block fills; flush() writes
+ * out whatever is left.
+ */
+class column_writer {
+private:
+        string_dict _dict {};
+        std::vector<uint32_t> _method {};
+        std::vector<uint32_t> _path {};
+        std::vector<uint8_t> _major {};
+        std::vector<uint8_t> _minor {};
+        std::vector<uint64_t> _length {};
+        std::vector<uint64_t> _seen {};
+        std::vector<uint32_t> _cache {};
+        std::vector<uint32_t> _max_age {};
+        std::vector<uint32_t> _field_end {};
+        std::vector<uint32_t> _field_name {};
+        std::vector<uint32_t> _accept_end {};
+        std::vector<uint32_t> _accept_type {};
+        std::vector<uint16_t> _accept_q {};
+        std::vector<uint32_t> _names {};
+        const void *_src {nullptr};
+        std::string _scratch {};
+        uint32_t name(const request& req, const field& f);
+public:
+        static const size_t BLOCK {4096};
+        bool add(FILE *fp, const request& req);
+        bool flush(FILE *fp);
+        size_t rows(void) const;
+};
+
+/*
+ * reads a columnar file back a block at a time. next() loads the
+ * next block; rows are then numbered from 0 within it.
+ */
+class column_reader {
+private:
+        FILE *_fp;
+        std::string _dict {};
+        std::vector<uint32_t> _ends {};
+        std::vector<uint32_t> _method {};
+        std::vector<uint32_t> _path {};
+        std::vector<uint8_t> _major {};
+        std::vector<uint8_t> _minor {};
+        std::vector<uint64_t> _length {};
+        std::vector<uint64_t> _seen {};
+        std::vector<uint32_t> _cache {};
+        std::vector<uint32_t> _max_age {};
+        std::vector<uint32_t> _field_end {};
+        std::vector<uint32_t> _field_name {};
+        std::vector<uint32_t> _accept_end {};
+        std::vector<uint32_t> _accept_type {};
+        std::vector<uint16_t> _accept_q {};
+        size_t _rows {0};
+        bool _bad {false};
+public:
+        column_reader(FILE *fp);
+        bool next(void);
+        bool bad(void) const;
+        size_t rows(void) const;
+        size_t strings(void) const;
+        span string(uint32_t id) const;
+        span method(size_t row) const;
+        span path(size_t row) const;
+        uint8_t major(size_t row) const;
+        uint8_t minor(size_t row) const;
+        uint64_t length(size_t row) const;
+        uint64_t seen(size_t row) const;
+        uint32_t cache(size_t row) const;
+        uint32_t max_age(size_t row) const;
+        size_t fields(size_t row) const;
+        uint32_t field_name(size_t row, size_t i) const;
+        size_t accepts(size_t row) const;
+        uint32_t accept_type(size_t row, size_t i) const;
+        uint16_t accept_q(size_t row, size_t i) const;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "decode.h"
+#include <climits>
+#include <cstring>
+#include <strings.h>
+
+body_decoder::body_decoder(body_cb out)
+        : _out {out}
+{
+}
+
+body_decoder::~body_decoder(void)
+{
+        if (_zinit)
+                inflateEnd(&_z);
+}
+
+static int sextet(char c)
+{
+        if (c >= 'A' && c <= 'Z')
+                return c - 'A';
+        if (c >= 'a' && c <= 'z')
+                return c - 'a' + 26;
+        if (c >= '0' && c <= '9')
+                return c - '0' + 52;
+        if (c == '+')
+                return 62;
+        if (c == '/')
+                return 63;
+        return -1;
+}
+
+/*
+ * a digest in base64: sixteen bytes are 22 characters and two of
+ * padding
+ */
+static bool unbase64(const astring& s, unsigned char out[md5::SIZE])
+{
+        if (s.size() != 24 || s[22] != '=' || s[23] != '=')
+                return false;
+
+        uint32_t acc = 0;
+        unsigned bits = 0;
+        size_t n = 0;
+        for (size_t i = 0; i < 22; i++) {
+                auto v = sextet(s[i]);
+                if (v < 0)
+                        return false;
+                acc = acc << 6 | v;
+                bits += 6;
+                if (bits >= 8) {
+                        bits -= 8;
+                        out[n++] = static_cast<unsigned char>(acc >> bits);
+                }
+        }
+        return n == md5::SIZE;
+}
+
+static bool is(const astring& s, const char *name)
+{
+        return strcasecmp(s.c_str(), name) == 0;
+}
+
+/*
+ * the first piece of a body: work out from the head what to do with
+ * the rest. one z_stream serves every body, reset rather than set up
+ * again.
+ */
+void body_decoder::start(const request& req)
+{
+        _busy = true;
+        _err = ERR_NONE;
+        _inflate = false;
+        _check = false;
+        _md5 = md5{};
+
+        if (!req.load(TOK_CONTENT_ENCODING)) {
+                _err = ERR_CODING;
+                return;
+        }
+        if (req.has(TOK_CONTENT_ENCODING) &&
+            !is(req.ctnt_encoding, "identity")) {
+                _gzip = is(req.ctnt_encoding, "gzip") ||
+                        is(req.ctnt_encoding, "x-gzip");
+                if (!_gzip && !is(req.ctnt_encoding, "deflate")) {
+                        _err = ERR_CODING;
+                        return;
+                }
+                /* deflate in HTTP is the zlib format, not raw deflate */
+                auto bits = _gzip ? 15 + 16 : 15;
+                auto r = _zinit ? inflateReset2(&_z, bits) :
+                        inflateInit2(&_z, bits);
+                _zinit = true;
+                if (r != Z_OK) {
+                        _err = ERR_CODING;
+                        return;
+                }
+                _inflate = true;
+                _ended = false;
+        }
+
+        if (!req.load(TOK_CONTENT_MD5) || (req.has(TOK_CONTENT_MD5) &&
+            !unbase64(req.md5, _want))) {
+                _err = ERR_DIGEST;
+                return;
+        }
+        _check = req.has(TOK_CONTENT_MD5);
+}
+
+/*
+ * inflate a piece into _chunk, handing each chunk on as it fills.
+ * inflate() is called again while the output is full, since it may
+ * hold more than the input it has taken would suggest.
+ */
+void body_decoder::inflate_some(const request& req, const char *buf,
+        size_t len)
+{
+        while (len != 0) {
+                auto take = static_cast<uInt>(len < UINT_MAX ? len :
+                        UINT_MAX);
+                _z.next_in = reinterpret_cast<Bytef *>(
+                        const_cast<char *>(buf));
+                _z.avail_in = take;
+                buf += take;
+                len -= take;
+
+                auto full = true;
+                while (_z.avail_in != 0 || full) {
+                        if (_ended) {
+                                if (_z.avail_in == 0)
+                                        break;
+                                /* gzip members may follow one another */
+                                if (!_gzip || inflateReset(&_z) != Z_OK) {
+                                        _err = ERR_CODING;
+                                        return;
+                                }
+                                _ended = false;
+                        }
+
+                        _z.next_out = _chunk;
+                        _z.avail_out = CHUNK;
+                        auto r = inflate(&_z, Z_NO_FLUSH);
+                        auto n = CHUNK - _z.avail_out;
+                        full = _z.avail_out == 0;
+                        if (r == Z_STREAM_END)
+                                _ended = true;
+                        else if (r != Z_OK && r != Z_BUF_ERROR)
+                                _err = ERR_CODING;
+                        if (_err != ERR_NONE)
+                                return;
+                        if (n != 0)
+                                _out(req, reinterpret_cast<char *>(_chunk),
+                                        n);
+                }
+        }
+}
+
+/*
+ * the body is in. a compressed stream that hasn't ended was cut
+ * short; the digest, if one was sent, has to match.
+ */
+void body_decoder::finish(const request& req)
+{
+        if (_err == ERR_NONE && _inflate && !_ended)
+                _err = ERR_CODING;
+        if (_err == ERR_NONE && _check) {
+                unsigned char got[md5::SIZE];
+                _md5.digest(got);
+                if (memcmp(got, _want, sizeof(got)) != 0)
+                        _err = ERR_DIGEST;
+        }
+        _busy = false;
+        _out(req, nullptr, 0);
+}
+
+/*
+ * a body_cb: a piece of the body, or its end when buf is null
+ */
+void body_decoder::feed(const request& req, const char *buf, size_t len)
+{
+        if (!_busy)
+                start(req);
+        if (buf == nullptr) {
+                finish(req);
+                return;
+        }
+        if (_err != ERR_NONE)
+                return;
+
+        if (_check)
+                _md5.update(buf, len);
+        if (_inflate)
+                inflate_some(req, buf, len);
+        else
+                _out(req, buf, len);
+}
+
+int body_decoder::error(void) const
+{
+        return _err;
+}
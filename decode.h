@@ -0,0 +1,53 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+#include "error.h"
+#include "md5.h"
+#include "parser.h"
+#include <zlib.h>
+
+/*
+ * a stage between the parser's body callback and the one it was
+ * built with: it undoes a gzip or deflate Content-Encoding and checks
+ * a Content-MD5, one piece of body at a time, so neither costs more
+ * than a pass over the bytes and no body is ever held whole. decoded
+ * bytes go out through a fixed buffer in pieces of at most CHUNK.
+ *
+ * the digest is of the body as sent, before decoding, as RFC 1864
+ * has it. error() says how the last body fared: ERR_CODING for a
+ * coding this can't undo or data that doesn't inflate, ERR_DIGEST
+ * for a Content-MD5 that is malformed or doesn't match. it is final
+ * by the time the callback sees the body's end, and nothing more of
+ * a body goes out once it is set.
+ *
+ * the bytes have to pass through feed(), so a caller decoding bodies
+ * can't move them itself with body_skip().
+ */
+class body_decoder {
+private:
+        static const size_t CHUNK {16384};
+        body_cb _out;
+        z_stream _z {};
+        md5 _md5 {};
+        unsigned char _want[md5::SIZE];
+        int _err {ERR_NONE};
+        bool _busy {false};
+        bool _zinit {false};
+        bool _inflate {false};
+        bool _gzip {false};
+        bool _ended {false};
+        bool _check {false};
+        unsigned char _chunk[CHUNK];
+        void start(const request& req);
+        void inflate_some(const request& req, const char *buf, size_t len);
+        void finish(const request& req);
+public:
+        body_decoder(body_cb out);
+        ~body_decoder(void);
+        body_decoder(const body_decoder&) = delete;
+        body_decoder& operator=(const body_decoder&) = delete;
+        void feed(const request& req, const char *buf, size_t len);
+        int error(void) const;
+};
+
+#endif
@@ -9,3 +9,26 @@ void usage(const char *fmt, ...)
         va_end(va);
         exit(EXIT_FAILURE);
 }
+
+const char *error_name(int code)
+{
+        static const char *names[ERR_COUNT] {
+                "no error",
+                "\\r not followed by \\n",
+                "bad character",
+                "malformed string literal",
+                "bad header",
+                "unexpected token",
+                "malformed chunk",
+                "bad message framing",
+                "bad number",
+                "bad request target",
+                "bad content coding",
+                "Content-MD5 mismatch",
+                "head or line too long",
+        };
+
+        if (code < 0 || code >= ERR_COUNT)
+                return "unknown error";
+        return names[code];
+}
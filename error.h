@@ -3,10 +3,40 @@
 
 #include <cerrno>
 #include <cstdarg>
+#include <cstddef>
 #include <cstdlib>
 #include <err.h>
 #include <sysexits.h>
 
+enum {
+        ERR_NONE,
+        ERR_CRLF,
+        ERR_CHAR,
+        ERR_STRING,
+        ERR_HEADER,
+        ERR_TOKEN,
+        ERR_CHUNK,
+        ERR_FRAMING,
+        ERR_NUMBER,
+        ERR_TARGET,
+        ERR_CODING,
+        ERR_DIGEST,
+        ERR_TOO_LONG,
+        ERR_COUNT,
+};
+
+/*
+ * why a parse failed. off is the byte offset in the input; expected
+ * and actual are TOK_* values and only mean something for ERR_TOKEN.
+ */
+struct parse_error {
+        int code;
+        size_t off;
+        int expected;
+        int actual;
+};
+
 void usage(const char *fmt, ...);
+const char *error_name(int code);
 
 #endif
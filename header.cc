@@ -0,0 +1,316 @@
+#include "header.h"
+#include "request.h"
+#include "token.h"
+#include <cstdint>
+#include <cstring>
+
+/*
+ * header names the lexer knows, and the Cache-Control directives the
+ * parser does. the lookup tables below are built from these at
+ * compile time, so a new one is one more line here.
+ */
+struct hdrname {
+        const char *name;
+        int type;
+};
+
+static constexpr hdrname hdrs[] {
+        {"Content-Length", TOK_CONTENT_LENGTH},
+        {"Accept", TOK_ACCEPT},
+        {"Accept-Charset", TOK_ACCEPT_CHARSET},
+        {"Accept-Encoding", TOK_ACCEPT_ENCODING},
+        {"Accept-Language", TOK_ACCEPT_LANGUAGE},
+        {"Authorization", TOK_AUTHORIZATION},
+        {"Cache-Control", TOK_CACHE_CONTROL},
+        {"Connection", TOK_CONNECTION},
+        {"Content-Encoding", TOK_CONTENT_ENCODING},
+        {"Content-Language", TOK_CONTENT_LANGUAGE},
+        {"Content-MD5", TOK_CONTENT_MD5},
+        {"Transfer-Encoding", TOK_TRANSFER_ENCODING},
+};
+
+/* in CC_* order, since cache_name() indexes it */
+static constexpr hdrname dirs[] {
+        {"no-cache", CC_NO_CACHE},
+        {"no-store", CC_NO_STORE},
+        {"max-age", CC_MAX_AGE},
+        {"max-stale", CC_MAX_STALE},
+        {"min-fresh", CC_MIN_FRESH},
+        {"s-maxage", CC_S_MAXAGE},
+        {"no-transform", CC_NO_TRANSFORM},
+        {"only-if-cached", CC_ONLY_IF_CACHED},
+        {"public", CC_PUBLIC},
+        {"private", CC_PRIVATE},
+        {"must-revalidate", CC_MUST_REVALIDATE},
+        {"proxy-revalidate", CC_PROXY_REVALIDATE},
+        {"must-understand", CC_MUST_UNDERSTAND},
+        {"immutable", CC_IMMUTABLE},
+        {"stale-while-revalidate", CC_STALE_WHILE_REVALIDATE},
+        {"stale-if-error", CC_STALE_IF_ERROR},
+};
+
+static constexpr size_t NHDRS {sizeof(hdrs) / sizeof(hdrs[0])};
+static constexpr size_t NDIRS {sizeof(dirs) / sizeof(dirs[0])};
+static constexpr unsigned SLOT_BITS {6};
+static constexpr size_t NSLOTS {size_t{1} << SLOT_BITS};
+
+static_assert(NHDRS < NSLOTS, "too many headers for the slot table");
+static_assert(NDIRS == CC_EXTENSION, "a directive is missing a name");
+
+static constexpr size_t cstrlen(const char *s)
+{
+        size_t n = 0;
+        while (s[n] != '\0')
+                n++;
+        return n;
+}
+
+static constexpr unsigned char lower(char c)
+{
+        return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+/*
+ * the key is the length and the first, middle and last bytes with
+ * case folded away, hashed by one multiply. which multiplier keeps
+ * every name of a table in its own slot is worked out at compile
+ * time.
+ */
+static constexpr unsigned slot(uint32_t seed, const char *p, size_t n)
+{
+        uint32_t key = (n & 0xff) |
+                lower(p[0]) << 8 |
+                lower(p[n / 2]) << 16 |
+                static_cast<uint32_t>(lower(p[n - 1])) << 24;
+        return static_cast<uint32_t>(key * seed) >> (32 - SLOT_BITS);
+}
+
+static constexpr bool in_order(const hdrname *names, size_t n)
+{
+        for (size_t i = 0; i < n; i++) {
+                if (names[i].type != static_cast<int>(i))
+                        return false;
+        }
+        return true;
+}
+
+static_assert(in_order(dirs, NDIRS), "directives must be in CC_* order");
+
+struct slottab {
+        uint32_t seed;
+        signed char idx[NSLOTS];
+};
+
+static constexpr bool try_seed(uint32_t seed, const hdrname *names,
+                size_t n, slottab& t)
+{
+        t.seed = seed;
+        for (size_t i = 0; i < NSLOTS; i++)
+                t.idx[i] = -1;
+        for (size_t i = 0; i < n; i++) {
+                auto s = slot(seed, names[i].name, cstrlen(names[i].name));
+                if (t.idx[s] != -1)
+                        return false;
+                t.idx[s] = i;
+        }
+        return true;
+}
+
+static constexpr slottab build(const hdrname *names, size_t n)
+{
+        slottab t {0, {}};
+        for (uint32_t seed = 0x9e3779b1; ; seed += 2) {
+                if (try_seed(seed, names, n, t))
+                        return t;
+        }
+}
+
+static constexpr slottab tab {build(hdrs, NHDRS)};
+static constexpr slottab dirtab {build(dirs, NDIRS)};
+
+static bool caseeq(const char *a, const char *b, size_t n)
+{
+        for (size_t i = 0; i < n; i++) {
+                if (lower(a[i]) != lower(b[i]))
+                        return false;
+        }
+        return true;
+}
+
+/*
+ * map a header name to its TOK_* value, ignoring case as RFC 7230
+ * asks, or return -1 if it is not one we know.
+ */
+static int lookup(const slottab& t, const hdrname *names,
+                const char *name, size_t len)
+{
+        if (len == 0)
+                return -1;
+
+        auto i = t.idx[slot(t.seed, name, len)];
+        if (i < 0)
+                return -1;
+
+        auto& h = names[i];
+        if (cstrlen(h.name) != len || !caseeq(h.name, name, len))
+                return -1;
+        return h.type;
+}
+
+int header_lookup(const char *name, size_t len)
+{
+        return lookup(tab, hdrs, name, len);
+}
+
+/*
+ * a known header's name as the table spells it, or null for a type
+ * that isn't a header
+ */
+const char *header_name(int type)
+{
+        for (const auto& h : hdrs) {
+                if (h.type == type)
+                        return h.name;
+        }
+        return nullptr;
+}
+
+static constexpr uint64_t known_mask(void)
+{
+        uint64_t m = 0;
+        for (const auto& h : hdrs)
+                m |= uint64_t{1} << h.type;
+        return m;
+}
+
+static constexpr uint64_t known {known_mask()};
+
+/* whether type is the TOK_* of a header in the table */
+bool header_known(int type)
+{
+        return type >= 0 && type < 64 && (known >> type & 1);
+}
+
+/*
+ * map a Cache-Control directive to its CC_* value, ignoring case, or
+ * return -1 for an extension.
+ */
+int cache_lookup(const char *name, size_t len)
+{
+        return lookup(dirtab, dirs, name, len);
+}
+
+const char *cache_name(int dir)
+{
+        if (dir < 0 || dir >= CC_EXTENSION)
+                return "extension";
+        return dirs[dir].name;
+}
+
+/* in METHOD_* order, since method_name() indexes it */
+static constexpr const char *methods[] {
+        "", "GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS",
+        "TRACE", "PATCH",
+};
+
+static_assert(sizeof(methods) / sizeof(methods[0]) == METHOD_COUNT,
+        "a method is missing a name");
+
+/* n bytes as memcpy() would load them into an integer that wide */
+static constexpr uint64_t bytes(const char *s, size_t n)
+{
+        uint64_t w = 0;
+        for (size_t i = 0; i < n; i++) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+                w |= uint64_t{static_cast<unsigned char>(s[i])} << i * 8;
+#else
+                w |= uint64_t{static_cast<unsigned char>(s[i])} <<
+                        (n - 1 - i) * 8;
+#endif
+        }
+        return w;
+}
+
+/*
+ * a method as method_lookup() loads it: three bytes as a 16-bit
+ * load with the third byte above it, four as one 32-bit load, and
+ * five to seven as two overlapping ones, the last four in the top
+ * half.
+ */
+static constexpr uint64_t word(const char *s, size_t n)
+{
+        return n == 3 ? bytes(s, 2) | bytes(s + 2, 1) << 16 :
+                n == 4 ? bytes(s, 4) :
+                bytes(s, 4) | bytes(s + n - 4, 4) << 32;
+}
+
+static constexpr uint64_t M(const char *s)
+{
+        return word(s, cstrlen(s));
+}
+
+static uint16_t load16(const char *p)
+{
+        uint16_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+}
+
+static uint32_t load32(const char *p)
+{
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+}
+
+/*
+ * map a method to its METHOD_* value, or METHOD_OTHER for any other.
+ * methods are case-sensitive. the name goes into an integer in one
+ * or two loads (see word()) and the length picks the constants it
+ * can equal, so there is no string compare at all.
+ */
+int method_lookup(const char *name, size_t len)
+{
+        uint64_t w;
+        switch (len) {
+        case 3:
+                w = load16(name) |
+                        uint32_t{static_cast<unsigned char>(name[2])} << 16;
+                if (w == M("GET"))
+                        return METHOD_GET;
+                if (w == M("PUT"))
+                        return METHOD_PUT;
+                return METHOD_OTHER;
+        case 4:
+                w = load32(name);
+                if (w == M("HEAD"))
+                        return METHOD_HEAD;
+                if (w == M("POST"))
+                        return METHOD_POST;
+                return METHOD_OTHER;
+        case 5:
+        case 6:
+        case 7:
+                w = load32(name) | uint64_t{load32(name + len - 4)} << 32;
+                if (w == M("PATCH") && len == 5)
+                        return METHOD_PATCH;
+                if (w == M("TRACE") && len == 5)
+                        return METHOD_TRACE;
+                if (w == M("DELETE") && len == 6)
+                        return METHOD_DELETE;
+                if (w == M("OPTIONS") && len == 7)
+                        return METHOD_OPTIONS;
+                if (w == M("CONNECT") && len == 7)
+                        return METHOD_CONNECT;
+                return METHOD_OTHER;
+        default:
+                return METHOD_OTHER;
+        }
+}
+
+const char *method_name(int method)
+{
+        if (method <= METHOD_OTHER || method >= METHOD_COUNT)
+                return nullptr;
+        return methods[method];
+}
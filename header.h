@@ -0,0 +1,14 @@
+#ifndef HEADER_H
+#define HEADER_H
+
+#include <cstddef>
+
+int header_lookup(const char *name, size_t len);
+const char *header_name(int type);
+bool header_known(int type);
+int cache_lookup(const char *name, size_t len);
+const char *cache_name(int dir);
+int method_lookup(const char *name, size_t len);
+const char *method_name(int method);
+
+#endif
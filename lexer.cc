@@ -1,162 +1,494 @@
 #include "lexer.h"
+#include "header.h"
+#include "scan.h"
+#include <cstring>
 
-static std::unordered_map<std::string,int> reqmap {
-        {"Content-Length", TOK_CONTENT_LENGTH},
-        {"Accept", TOK_ACCEPT},
-        {"Accept-Charset", TOK_ACCEPT_CHARSET},
-        {"Accept-Encoding", TOK_ACCEPT_ENCODING},
-        {"Accept-Language", TOK_ACCEPT_LANGUAGE},
-        {"Authorization", TOK_AUTHORIZATION},
-        {"Cache-Control", TOK_CACHE_CONTROL},
-        {"Connection", TOK_CONNECTION},
-        {"Content-Encoding", TOK_CONTENT_ENCODING},
-        {"Content-Language", TOK_CONTENT_LANGUAGE},
-        {"Content-MD5", TOK_CONTENT_MD5},
-};
+lexer::lexer(const char *buf, size_t len, int mode)
+{
+        reset(buf, len, mode);
+}
 
 lexer::lexer(FILE *fp)
-        : _fp {fp}
 {
-        if (_fp == nullptr) {
+        if (fp == nullptr) {
                 usage("bad FILE*");
         }
+
+        char chunk[BUFSIZ];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+                _own.append(chunk, n);
+        if (ferror(fp))
+                usage("fread");
+        if (_own.size() > UINT32_MAX)
+                usage("input too large");
+
+        _buf = _own.data();
+        _len = _own.size();
 }
 
-const token& lexer::next(void)
+/*
+ * lex straight out of a mapping, with no copy
+ */
+lexer::lexer(const mapped_file& f)
 {
-        for (;;) {
-                auto c = _putback;
-                if (c != 0)
-                        _putback = 0;
-                else
-                        c = fgetc(_fp);
+        reset(f.data(), f.size());
+}
 
-                if ((_inval || _first) && c == ' ')
-                        continue;
+/*
+ * restart on a new buffer. mode says whether the buffer begins with
+ * the request line, a header line or the value part of a header.
+ */
+void lexer::reset(const char *buf, size_t len, int mode)
+{
+        if (buf == nullptr && len != 0) {
+                usage("bad buffer");
+        }
 
-                std::string s;
-                switch (c) {
-                case EOF:
-                        return _curr = token{};
-                case '\r':
-                        if (fgetc(_fp) != '\n')
-                                usage("\\r not followed by \\n");
-                        _first = false;
-                        _inhdr = true;
-                        _inval = false;
-                        return _curr = token{TOK_EOL};
-                case '/':
-                        return _curr = token{TOK_SLASH};
-                case ':':
-                        _inhdr = false;
-                        _inval = true;
-                        return _curr = token{TOK_COLON};
-                case '.':
-                        return _curr = token{TOK_DOT};
-                case '=':
-                        return _curr = token{TOK_EQ};
-                case ',':
-                        return _curr = token{TOK_COMMA};
-                case ';':
-                        return _curr = token{TOK_SEMI};
-                case '"':
-                        s = "";
-                        while ((c = fgetc(_fp)) != EOF && c != '"') {
-                                s += c;
-                        }
-                        if (c == EOF)
-                                usage("malformed string literal");
-                        return _curr = token{TOK_STR, s};
-                }
+        _ntok = 0;
+        _itok = 0;
+        _stop = token{};
+        _cur = &_stop;
+        _buf = buf;
+        _len = len;
+        _pos = 0;
+        _mode = mode;
+        _err = parse_error{ERR_NONE, 0, TOK_EOF, TOK_EOF};
+        _pend = _err;
+        /* offsets are 32 bits; a longer buffer fails at its first token */
+        if (len > UINT32_MAX) {
+                _len = 0;
+                _pend = parse_error{ERR_TOO_LONG, 0, TOK_EOF, TOK_EOF};
+        }
+}
 
-                if (_inhdr && (isalpha(c) || c == '-')) {
-                        std::string s {};
-                        while (isalpha(c) || c == '-' || isdigit(c)) {
-                                s += c;
-                                c = fgetc(_fp);
-                        }
-                        _putback = c;
-                        auto p = reqmap.find(s);
-                        if (p == reqmap.end())
-                                usage("bad header: %s", s.c_str());
+/*
+ * record the first error and stop: jump to the end of the buffer
+ * and stick on TOK_EOL.
+ */
+const token& lexer::fail(int code, size_t off, int expected)
+{
+        if (_err.code == ERR_NONE)
+                _err = parse_error{code, off, expected, _cur->type()};
+        _pos = _len;
+        _ntok = 0;
+        _itok = 0;
+        _stop = token{TOK_EOL, off};
+        return *(_cur = &_stop);
+}
 
-                        return _curr = token{p->second};
-                }
+/*
+ * the lexer is a DFA whose table is built at compile time. the
+ * first three states are the modes a token can start in; the rest
+ * are inside a token. a step either takes the byte and moves on,
+ * drops it (spaces between tokens), takes it as the last byte of a
+ * one-byte token, or ends the token before it.
+ */
+enum {
+        S_REQLINE = LEX_REQLINE,
+        S_HEADER = LEX_HEADER,
+        S_VALUE = LEX_VALUE,
+        S_FIELD,        /* after an unknown header name */
+        S_RAW,          /* its value, taken whole */
+        S_TARGET,       /* after the method */
+        S_METHOD,       /* letters on the request line */
+        S_PATH,         /* the request-target */
+        S_NAME,         /* a header name */
+        S_WORD,         /* a word in a value */
+        S_INT,
+        S_FRAC,
+        S_CR,
+        S_COUNT,
+};
 
-                if (_first && isalpha(c)) {
-                        std::string s {};
-                        while (isalpha(c)) {
-                                s += c;
-                                c = fgetc(_fp);
-                        }
-                        _putback = c;
-                        if (s == "GET")
-                                return _curr = token{TOK_GET, s};
-                        if (s == "HTTP")
-                                return _curr = token{TOK_HTTP, s};
-                        return _curr = token{TOK_WORD, s};
-                }
+enum {
+        A_GO,           /* take the byte and move to next */
+        A_SKIP,         /* drop the byte; the token starts after it */
+        A_EMIT,         /* take the byte as a whole token of type arg */
+        A_END,          /* the token ended before this byte */
+        A_STR,          /* a quoted string starts */
+        A_TEXT,         /* the rest of the line is one token */
+        A_FAIL,         /* error arg at the start of the token */
+};
 
-                if (_inval && (isalpha(c) || c == '-' || c == '*')) {
-                        std::string s {};
-                        while (isalpha(c) || isdigit(c) ||
-                                        c == '-' || c == '*') {
-                                s += c;
-                                c = fgetc(_fp);
-                        }
-                        _putback = c;
-                        return _curr = token{TOK_WORD, s};
-                }
+struct step {
+        uint8_t act;
+        uint8_t arg;
+        uint8_t next;
+        uint8_t pad;    /* four bytes, so a step is found with a shift */
+};
 
-                if (isdigit(c)) {
-                        std::string s {};
-                        while (isdigit(c)) {
-                                s += c;
-                                c = fgetc(_fp);
+enum {
+        C_OTHER,
+        C_SP,
+        C_CR,
+        C_LF,
+        C_ALPHA,
+        C_DIGIT,
+        C_DASH,
+        C_STAR,
+        C_QUOTE,
+        C_PUNCT,        /* a one-byte token */
+        C_TCHAR,        /* other punctuation allowed in header names */
+};
+
+static constexpr int cls(int c)
+{
+        return (c | 0x20) >= 'a' && (c | 0x20) <= 'z' ? C_ALPHA :
+                c >= '0' && c <= '9' ? C_DIGIT :
+                c == ' ' ? C_SP :
+                c == '\r' ? C_CR :
+                c == '\n' ? C_LF :
+                c == '-' ? C_DASH :
+                c == '*' ? C_STAR :
+                c == '"' ? C_QUOTE :
+                c == '/' || c == ':' || c == '.' || c == '=' ||
+                c == ',' || c == ';' ? C_PUNCT :
+                c == '!' || c == '#' || c == '$' || c == '%' || c == '&' ||
+                c == '\'' || c == '+' || c == '^' || c == '_' ||
+                c == '`' || c == '|' || c == '~' ? C_TCHAR : C_OTHER;
+}
+
+static constexpr int punct(int c)
+{
+        return c == '/' ? TOK_SLASH :
+                c == ':' ? TOK_COLON :
+                c == '.' ? TOK_DOT :
+                c == '=' ? TOK_EQ :
+                c == ',' ? TOK_COMMA : TOK_SEMI;
+}
+
+static constexpr step go(int s)
+{
+        return step{A_GO, 0, static_cast<uint8_t>(s), 0};
+}
+
+static constexpr step act(int a, int arg = 0, int next = 0)
+{
+        return step{static_cast<uint8_t>(a), static_cast<uint8_t>(arg),
+                static_cast<uint8_t>(next), 0};
+}
+
+/* a byte RFC 7230 allows in a header name */
+static constexpr bool tchar(int c)
+{
+        return cls(c) == C_ALPHA || cls(c) == C_DIGIT || cls(c) == C_DASH ||
+                cls(c) == C_STAR || cls(c) == C_TCHAR || c == '.';
+}
+
+/*
+ * the first byte of a token. spaces separate tokens on the request
+ * line and in values but not in header names; a colon after a
+ * header name switches to values, and every line after the first
+ * starts with a header name.
+ */
+static constexpr step start(int s, int c)
+{
+        if (s == S_HEADER && tchar(c))
+                return go(S_NAME);
+        if (s == S_FIELD)
+                return c == ':' ? act(A_EMIT, TOK_COLON, S_RAW) :
+                        start(S_HEADER, c);
+        if (s == S_RAW)
+                return c == ' ' ? act(A_SKIP) :
+                        c == '\r' ? go(S_CR) :
+                        (c < ' ' && c != '\t') || c == 0x7f ?
+                        act(A_FAIL, ERR_CHAR) : act(A_TEXT);
+        if (s == S_TARGET && c > ' ' && c < 0x7f)
+                return go(S_PATH);
+
+        switch (cls(c)) {
+        case C_SP:
+                return s == S_HEADER ? act(A_FAIL, ERR_CHAR) : act(A_SKIP);
+        case C_CR:
+                return go(S_CR);
+        case C_ALPHA:
+                return go(s == S_REQLINE ? S_METHOD : S_WORD);
+        case C_DIGIT:
+                return go(S_INT);
+        case C_DASH:
+        case C_STAR:
+                return s == S_VALUE ? go(S_WORD) : act(A_FAIL, ERR_CHAR);
+        case C_QUOTE:
+                return act(A_STR);
+        case C_PUNCT:
+                return act(A_EMIT, punct(c),
+                        s == S_HEADER && c == ':' ? S_VALUE : s);
+        }
+        return act(A_FAIL, ERR_CHAR);
+}
+
+static constexpr step rule(int s, int c)
+{
+        auto k = cls(c);
+        switch (s) {
+        case S_METHOD:
+                return k == C_ALPHA ? go(s) : act(A_END);
+        case S_PATH:
+                return c > ' ' && c < 0x7f ? go(s) : act(A_END);
+        case S_NAME:
+                return tchar(c) ? go(s) : act(A_END);
+        case S_WORD:
+                return k == C_ALPHA || k == C_DIGIT || k == C_DASH ||
+                        k == C_STAR ? go(s) : act(A_END);
+        case S_INT:
+                return k == C_DIGIT ? go(s) :
+                        c == '.' ? go(S_FRAC) : act(A_END);
+        case S_FRAC:
+                return k == C_DIGIT ? go(s) : act(A_END);
+        case S_CR:
+                return k == C_LF ? act(A_EMIT, TOK_EOL, S_HEADER) :
+                        act(A_FAIL, ERR_CRLF);
+        }
+        return start(s, c);
+}
+
+struct dfa_table {
+        step t[S_COUNT][256];
+};
+
+static constexpr dfa_table build(void)
+{
+        dfa_table d {};
+        for (int s = 0; s < S_COUNT; s++) {
+                for (int c = 0; c < 256; c++)
+                        d.t[s][c] = rule(s, c);
+        }
+        return d;
+}
+
+static constexpr dfa_table dfa = build();
+
+/*
+ * the next token into t. false on a lexical error, which is left in
+ * _pend for whoever reaches it.
+ */
+bool lexer::scan(token& t)
+{
+        int s = _mode;
+        auto start = _pos;
+        while (_pos < _len) {
+                auto& st = dfa.t[s][static_cast<unsigned char>(_buf[_pos])];
+                switch (st.act) {
+                case A_GO:
+                        _pos++;
+                        s = st.next;
+                        /* the long self-loops run on the word scanner */
+                        if (s == S_NAME)
+                                _pos += scan_word(_buf + _pos, _len - _pos,
+                                        '-', '-');
+                        else if (s == S_WORD)
+                                _pos += scan_word(_buf + _pos, _len - _pos,
+                                        '-', '*');
+                        else if (s == S_PATH)
+                                _pos += scan_word(_buf + _pos, _len - _pos,
+                                        '/', '.');
+                        continue;
+                case A_SKIP:
+                        start = ++_pos;
+                        continue;
+                case A_EMIT:
+                        _pos++;
+                        _mode = st.next;
+                        t = token{st.arg, start, _pos - start};
+                        return true;
+                case A_END:
+                        return accept(t, s, start);
+                case A_STR:
+                        _pos++;
+                        _pos += scan_byte(_buf + _pos, _len - _pos, '"');
+                        if (_pos == _len) {
+                                _pend = parse_error{ERR_STRING, start,
+                                        TOK_EOF, TOK_EOF};
+                                return false;
                         }
-                        if (c == '.') {
-                                s += c;
-                                c = fgetc(_fp);
-                                while (isdigit(c)) {
-                                        s += c;
-                                        c = fgetc(_fp);
-                                }
+                        _pos++;
+                        t = token{TOK_STR, start + 1, _pos - start - 2};
+                        return true;
+                case A_TEXT:
+                        /* the line has to end there (RFC 7230, 3.2.4) */
+                        _pos += scan_ctl(_buf + _pos, _len - _pos);
+                        if (_pos < _len && _buf[_pos] != '\r') {
+                                _pend = parse_error{ERR_CHAR, _pos,
+                                        TOK_EOF, TOK_EOF};
+                                return false;
                         }
-                        _putback = c;
-                        return _curr = token{TOK_NUM, s};
+                        t = token{TOK_STR, start, _pos - start};
+                        return true;
+                default:
+                        _pend = parse_error{st.arg, start, TOK_EOF, TOK_EOF};
+                        return false;
                 }
+        }
+
+        if (s == S_CR) {
+                _pend = parse_error{ERR_CRLF, start, TOK_EOF, TOK_EOF};
+                return false;
+        }
+        if (s >= S_METHOD)
+                return accept(t, s, start);
+        t = token{TOK_EOF, _pos};
+        return true;
+}
 
-                usage("bad character: %c", c);
+/*
+ * the token that state s was in the middle of ends at _pos
+ */
+bool lexer::accept(token& t, int s, size_t start)
+{
+        auto n = _pos - start;
+        if (s == S_NAME) {
+                auto type = header_lookup(_buf + start, n);
+                t = token{type < 0 ? TOK_FIELD : type, start, n};
+                if (type < 0)
+                        _mode = S_FIELD;
+        } else if (s == S_METHOD) {
+                /*
+                 * the version's "HTTP" or a method; which method is
+                 * the parser's business (method_lookup())
+                 */
+                if (n == 4 && memcmp(_buf + start, "HTTP", 4) == 0) {
+                        t = token{TOK_HTTP, start, n};
+                } else {
+                        t = token{TOK_METHOD, start, n};
+                        /* the request-target follows the method */
+                        _mode = S_TARGET;
+                }
+        } else if (s == S_PATH) {
+                t = token{TOK_PATH, start, n};
+                _mode = S_REQLINE;
+        } else if (s == S_WORD) {
+                t = token{TOK_WORD, start, n};
+        } else {
+                t = token{TOK_NUM, start, n};
         }
+        return true;
+}
+
+/* the modes of the request line, which is lexed in one run */
+static bool reqline(int mode)
+{
+        return mode == S_REQLINE || mode == S_TARGET;
+}
+
+/*
+ * fill out with tokens up to and including the end of the run: EOF,
+ * or the token after which the mode changes. stops early on an error
+ * or when out is full.
+ */
+size_t lexer::batch(token *out, size_t n)
+{
+        size_t i = 0;
+        while (i < n && _pend.code == ERR_NONE) {
+                auto mode = _mode;
+                if (!scan(out[i]))
+                        break;
+                auto type = out[i++].type();
+                if (type == TOK_EOF || (_mode != mode &&
+                    !(reqline(mode) && reqline(_mode))))
+                        break;
+        }
+#ifdef PARSE_STATS
+        _lexed += i;
+#endif
+        return i;
+}
+
+/*
+ * next() ran off the end of the array: lex the next run, or report
+ * the error that ended the last one.
+ */
+const token& lexer::refill(void)
+{
+        if (_err.code != ERR_NONE)
+                return *_cur;
+
+        _ntok = _pend.code == ERR_NONE ? batch(_toks, BATCH) : 0;
+        _itok = 0;
+        if (_ntok == 0)
+                return fail(_pend.code, _pend.off);
+        return *(_cur = &_toks[_itok++]);
+}
+
+/*
+ * lex up to n tokens into out in one go, as far as EOF, which is
+ * included. on an error the last token is a TOK_EOL at the failure
+ * and error() says what it was. returns how many were written.
+ */
+size_t lexer::tokenize(token *out, size_t n)
+{
+        size_t i = 0;
+        while (i < n && _err.code == ERR_NONE) {
+                if (_itok < _ntok) {
+                        out[i] = _toks[_itok++];
+                        if (out[i++].type() == TOK_EOF)
+                                break;
+                        continue;
+                }
+                auto got = batch(out + i, n - i);
+                i += got;
+                if (_pend.code != ERR_NONE && i < n) {
+                        out[i++] = fail(_pend.code, _pend.off);
+                        break;
+                }
+                if (got != 0 && out[i - 1].type() == TOK_EOF)
+                        break;
+        }
+        return i;
 }
 
 const token& lexer::curr(void) const
 {
-        return _curr;
+        return *_cur;
 }
 
 void lexer::skip(int type)
 {
-        if (_curr.type() == type) {
+        if (_cur->type() == type) {
                 next();
                 return;
         }
-        usage("expected %s, got %s",
-            token{type}.name().c_str(), _curr.name().c_str());
+        fail(ERR_TOKEN, _cur->off(), type);
+}
+
+/*
+ * fail at the current token for a reason only the grammar knows,
+ * such as a number that is out of range
+ */
+void lexer::reject(int code)
+{
+        fail(code, _cur->off());
 }
 
 int lexer::type(void) const
 {
-        return _curr.type();
+        return _cur->type();
+}
+
+span lexer::lex(void) const
+{
+        return text(*_cur);
 }
 
-const std::string& lexer::lex(void) const
+span lexer::text(const token& tok) const
 {
-        return _curr.lex();
+        return span{_buf + tok.off(), tok.len()};
 }
 
-const std::string& lexer::name(void) const
+const char *lexer::name(void) const
 {
-        return _curr.name();
+        return _cur->name();
 }
 
+const parse_error& lexer::error(void) const
+{
+        return _err;
+}
+
+#ifdef PARSE_STATS
+/* tokens lexed over the lexer's life, for the parser's stats */
+const uint64_t& lexer::lexed(void) const
+{
+        return _lexed;
+}
+#endif
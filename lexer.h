@@ -2,27 +2,84 @@
 #define LEXER_H
 
 #include "error.h"
+#include "mapfile.h"
+#include "span.h"
 #include "token.h"
+#include <cstdint>
 #include <cstdio>
 #include <string>
-#include <unordered_map>
 
+enum {
+        LEX_REQLINE,
+        LEX_HEADER,
+        LEX_VALUE,
+};
+
+/*
+ * lexes a contiguous buffer owned by the caller. tokens are views
+ * into that buffer, so it must outlive the lexer and every token.
+ *
+ * tokens are produced a run at a time into a small array that next()
+ * then steps through; a run ends at EOF or where the mode changes,
+ * after a header name's colon or a line's CRLF, so a value nobody
+ * asks for is never lexed. tokenize() hands whole runs to the caller.
+ *
+ * the request-target comes back whole as TOK_PATH. a header name
+ * that isn't known comes back as TOK_FIELD, and its value, whatever
+ * it holds, as a single TOK_STR.
+ *
+ * errors don't stop the program: the first one is recorded and from
+ * then on the lexer only returns TOK_EOL, which unwinds every loop
+ * in the grammar without further checks. an error found while
+ * filling the array is held back until next() reaches it.
+ */
 class lexer {
 private:
-        token _curr {};
-        FILE* _fp {stdin};
-        bool _first {true};
-        bool _inhdr {false};
-        bool _inval {false};
-        int _putback {0};
+        static const size_t BATCH {32};
+        token _toks[BATCH];
+        size_t _ntok {0};
+        size_t _itok {0};
+        const token *_cur {&_stop};
+        token _stop {};
+        std::string _own {};
+        const char *_buf {nullptr};
+        size_t _len {0};
+        size_t _pos {0};
+        uint8_t _mode {LEX_REQLINE};
+        parse_error _err {ERR_NONE, 0, TOK_EOF, TOK_EOF};
+        parse_error _pend {ERR_NONE, 0, TOK_EOF, TOK_EOF};
+#ifdef PARSE_STATS
+        uint64_t _lexed {0};
+#endif
+        const token& fail(int code, size_t off, int expected = TOK_EOF);
+        const token& refill(void);
+        size_t batch(token *out, size_t n);
+        bool scan(token& t);
+        bool accept(token& t, int s, size_t start);
 public:
+        lexer(const char *buf, size_t len, int mode = LEX_REQLINE);
         lexer(FILE *fp = stdin);
-        const token& next(void);
+        lexer(const mapped_file& f);
+        void reset(const char *buf, size_t len, int mode = LEX_REQLINE);
+        size_t tokenize(token *out, size_t n);
         const token& curr(void) const;
         void skip(int type);
+        void reject(int code);
         int type(void) const;
-        const std::string& lex(void) const;
-        const std::string& name(void) const;
+        span lex(void) const;
+        span text(const token& tok) const;
+        const char *name(void) const;
+        const parse_error& error(void) const;
+#ifdef PARSE_STATS
+        const uint64_t& lexed(void) const;
+#endif
+
+        const token& next(void)
+        {
+                if (_itok < _ntok)
+                        return *(_cur = &_toks[_itok++]);
+                return refill();
+        }
 };
 
 #endif
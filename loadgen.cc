@@ -0,0 +1,271 @@
+#include "batch.h"
+#include "error.h"
+#include "mapfile.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * a client connection. up to depth requests are in flight at once;
+ * sent holds when each went out so the matching response can be
+ * timed. responses are counted by the blank line that ends them,
+ * which is all the test server sends.
+ */
+struct client {
+        int fd;
+        size_t next;
+        std::deque<uint64_t> sent;
+        std::string out;
+        int match;
+};
+
+struct worker {
+        std::vector<uint64_t> lat;
+        size_t errors;
+        size_t reconnects;
+};
+
+static uint64_t now_ns(void)
+{
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(
+                steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * cut a capture into its requests, bodies included
+ */
+static std::vector<std::string> requests(const mapped_file& f)
+{
+        std::vector<std::string> reqs;
+        for (size_t off = 0; off < f.size(); ) {
+                auto end = batch_boundary(f.data(), f.size(), off);
+                reqs.emplace_back(f.data() + off, end - off);
+                off = end;
+        }
+        return reqs;
+}
+
+static int dial(int port)
+{
+        auto fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd < 0)
+                err(EX_OSERR, "socket");
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        sockaddr_in sa {};
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(port);
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) < 0 &&
+                        errno != EINPROGRESS) {
+                err(EX_UNAVAILABLE, "connect");
+        }
+        return fd;
+}
+
+static void send_more(client& c, const std::vector<std::string>& reqs,
+                size_t depth)
+{
+        while (c.sent.size() < depth) {
+                c.out += reqs[c.next++ % reqs.size()];
+                c.sent.push_back(now_ns());
+        }
+
+        while (!c.out.empty()) {
+                auto n = write(c.fd, c.out.data(), c.out.size());
+                if (n <= 0)
+                        break;
+                c.out.erase(0, n);
+        }
+}
+
+/*
+ * count completed responses in what was read, carrying a partial
+ * CRLFCRLF match over to the next read
+ */
+static size_t responses(client& c, const char *buf, size_t n)
+{
+        static const char end[] {"\r\n\r\n"};
+        size_t done = 0;
+        for (size_t i = 0; i < n; i++) {
+                if (buf[i] == end[c.match]) {
+                        if (++c.match == 4) {
+                                done++;
+                                c.match = 0;
+                        }
+                } else {
+                        c.match = buf[i] == '\r' ? 1 : 0;
+                }
+        }
+        return done;
+}
+
+/*
+ * the server closed on us, normally after a Connection: close.
+ * whatever was still in flight is dropped and the client starts over
+ * on a new connection.
+ */
+static void redial(int ep, int port, client& c)
+{
+        epoll_ctl(ep, EPOLL_CTL_DEL, c.fd, nullptr);
+        close(c.fd);
+        c.fd = dial(port);
+        c.sent.clear();
+        c.out.clear();
+        c.match = 0;
+
+        epoll_event ev {};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = &c;
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, c.fd, &ev) < 0)
+                err(EX_OSERR, "epoll_ctl");
+}
+
+static void run(int port, int conns, double secs, size_t depth,
+                const std::vector<std::string>& reqs, worker& w)
+{
+        auto ep = epoll_create1(0);
+        if (ep < 0)
+                err(EX_OSERR, "epoll_create1");
+
+        std::vector<client> cs(conns);
+        for (int i = 0; i < conns; i++) {
+                cs[i] = client{dial(port), static_cast<size_t>(i), {}, {}, 0};
+                epoll_event ev {};
+                ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                ev.data.ptr = &cs[i];
+                if (epoll_ctl(ep, EPOLL_CTL_ADD, cs[i].fd, &ev) < 0)
+                        err(EX_OSERR, "epoll_ctl");
+        }
+
+        auto stop = now_ns() + static_cast<uint64_t>(secs * 1e9);
+        epoll_event evs[256];
+        char buf[16384];
+        while (now_ns() < stop) {
+                auto n = epoll_wait(ep, evs, 256, 10);
+                for (int i = 0; i < n; i++) {
+                        auto& c = *static_cast<client *>(evs[i].data.ptr);
+                        if (evs[i].events & EPOLLERR) {
+                                w.errors++;
+                                redial(ep, port, c);
+                                continue;
+                        }
+
+                        ssize_t r;
+                        while ((r = read(c.fd, buf, sizeof(buf))) > 0) {
+                                auto t = now_ns();
+                                auto k = responses(c, buf, r);
+                                while (k-- > 0 && !c.sent.empty()) {
+                                        w.lat.push_back(t - c.sent.front());
+                                        c.sent.pop_front();
+                                }
+                        }
+                        if (r == 0 || (evs[i].events & EPOLLHUP)) {
+                                w.reconnects++;
+                                redial(ep, port, c);
+                        }
+                        send_more(c, reqs, depth);
+                }
+        }
+
+        for (auto& c : cs)
+                close(c.fd);
+        close(ep);
+}
+
+static double pct(const std::vector<uint64_t>& lat, double p)
+{
+        if (lat.empty())
+                return 0;
+        auto i = static_cast<size_t>(p * (lat.size() - 1));
+        return lat[i] / 1e3;
+}
+
+int main(int argc, char **argv)
+{
+        auto port = 8080;
+        auto conns = 1000;
+        auto threads = 1;
+        auto secs = 5.0;
+        size_t depth = 1;
+        int c;
+
+        while ((c = getopt(argc, argv, "p:c:t:d:P:")) != -1) {
+                switch (c) {
+                case 'p':
+                        port = atoi(optarg);
+                        break;
+                case 'c':
+                        conns = atoi(optarg);
+                        break;
+                case 't':
+                        threads = atoi(optarg);
+                        break;
+                case 'd':
+                        secs = atof(optarg);
+                        break;
+                case 'P':
+                        depth = strtoul(optarg, nullptr, 10);
+                        break;
+                default:
+                        usage("usage: %s [-p port] [-c conns] [-t threads] "
+                            "[-d seconds] [-P pipeline] [file]", argv[0]);
+                }
+        }
+        if (threads < 1 || conns < threads || depth == 0)
+                usage("need conns >= threads >= 1 and pipeline >= 1");
+
+        auto path = optind < argc ? argv[optind] : "req";
+        mapped_file f;
+        if (!f.open(path))
+                err(EX_NOINPUT, "%s", path);
+        auto reqs = requests(f);
+        if (reqs.empty())
+                usage("%s: no requests", path);
+
+        std::vector<worker> ws(threads);
+        std::vector<std::thread> ts;
+        auto start = now_ns();
+        for (int t = 0; t < threads; t++) {
+                auto n = conns / threads + (t < conns % threads);
+                ts.emplace_back(run, port, n, secs, depth, std::cref(reqs),
+                        std::ref(ws[t]));
+        }
+        for (auto& t : ts)
+                t.join();
+        auto elapsed = (now_ns() - start) / 1e9;
+
+        std::vector<uint64_t> lat;
+        size_t errors = 0;
+        size_t reconnects = 0;
+        for (auto& w : ws) {
+                lat.insert(lat.end(), w.lat.begin(), w.lat.end());
+                errors += w.errors;
+                reconnects += w.reconnects;
+        }
+        std::sort(lat.begin(), lat.end());
+
+        printf("{\"conns\":%d,\"threads\":%d,\"pipeline\":%zu,"
+                "\"seconds\":%.2f,\"requests\":%zu,\"errors\":%zu,"
+                "\"reconnects\":%zu,"
+                "\"req_per_s\":%.0f,\"p50_us\":%.1f,\"p99_us\":%.1f,"
+                "\"p999_us\":%.1f}\n",
+                conns, threads, depth, elapsed, lat.size(), errors,
+                reconnects,
+                lat.size() / elapsed, pct(lat, 0.5), pct(lat, 0.99),
+                pct(lat, 0.999));
+}
@@ -1,308 +1,237 @@
-#include "lexer.h"
-#include <vector>
-#include <unordered_set>
-
-struct media {
-        std::string type;
-        std::string subtype;
-        float arg;
-};
-
-struct charset {
-        std::string type;
-        float arg;
-};
-
-struct encoding {
-        std::string type;
-        float arg;
-};
-
-struct language {
-        std::string type;
-        float arg;
-};
+#include "batch.h"
+#include "column.h"
+#include "header.h"
+#include "mapfile.h"
+#include "parser.h"
+#include <cinttypes>
+#include <string>
+#include <unistd.h>
+
+static void die(const parse_error& e)
+{
+        if (e.code == ERR_TOKEN) {
+                usage("byte %zu: expected %s, got %s", e.off,
+                    token_name(e.expected), token_name(e.actual));
+        }
+        usage("byte %zu: %s", e.off, error_name(e.code));
+}
 
-struct cache_dir {
-        std::string type;
-        std::string s_arg;
-        float n_arg {0};
-};
+static void print_span(FILE *fp, span s)
+{
+        fprintf(fp, ", %.*s", static_cast<int>(s.size()), s.data());
+}
 
-struct cache_ctl {
-        cache_dir reqdir;
-        cache_dir resdir;
-};
+static bool print_request(FILE *fp, const request& req)
+{
+        for (int hdr = 0; hdr < TOK_COUNT; hdr++) {
+                if (!req.load(hdr))
+                        return false;
+        }
 
-struct request {
-        std::string method;
-        std::string path;
-        float version;
-        int len;
-        std::vector<media> accept;
-        std::vector<charset> charsets;
-        std::vector<encoding> encodings;
-        std::vector<language> langs;
-        std::string auth;
-        std::string connect;
-        std::string ctnt_encoding;
-        cache_ctl cache;
-        std::vector<language> ctnt_langs;
-        std::string md5;
-};
+        fprintf(fp, "method=%s\n", req.method.c_str());
+        if (req.verb == METHOD_CONNECT) {
+                auto a = req.text(req.target);
+                fprintf(fp, "authority=%.*s\n", static_cast<int>(a.size()),
+                        a.data());
+        } else {
+                fprintf(fp, "path=%s\n", req.path.c_str());
+        }
+        if (req.query.len != 0) {
+                auto q = req.text(req.query);
+                fprintf(fp, "query=%.*s\n", static_cast<int>(q.size()),
+                        q.data());
+        }
+        fprintf(fp, "version=%u.%u\n", req.major, req.minor);
+        fprintf(fp, "Content-Length: %" PRIu64 "\n", req.len);
 
-int main(void)
-{
-        request req;
-        lexer lex {};
+        fprintf(fp, "Accept:\n");
+        for (const auto& m : req.accept) {
+                fprintf(fp, "\t%s, %s, %u.%03u\n", m.type.c_str(),
+                                m.subtype.c_str(), m.q / 1000, m.q % 1000);
+        }
 
-        lex.next();
-        req.method = lex.lex();
-        lex.next();
-        while (lex.type() != TOK_HTTP) {
-                if (lex.type() == TOK_SLASH)
-                        req.path += "/";
-                else
-                        req.path += lex.lex();
-                lex.next();
+        fprintf(fp, "Accept-Charset:\n");
+        for (const auto& s : req.charsets)
+                fprintf(fp, "\t%s, %u.%03u\n", s.type.c_str(),
+                                s.q / 1000, s.q % 1000);
+
+        fprintf(fp, "Accept-Encoding:\n");
+        for (const auto& e : req.encodings)
+                fprintf(fp, "\t%s, %u.%03u\n", e.type.c_str(),
+                                e.q / 1000, e.q % 1000);
+
+        fprintf(fp, "Accept-Language:\n");
+        for (const auto& l : req.langs)
+                fprintf(fp, "\t%s, %u.%03u\n", l.type.c_str(),
+                                l.q / 1000, l.q % 1000);
+
+        fprintf(fp, "Authorization:\n\t%s\n", req.auth.c_str());
+
+        fprintf(fp, "Cache-Control:\n");
+        const auto& cc = req.cache;
+        for (int dir = 0; dir < CC_COUNT; dir++) {
+                if (!cc.has(dir))
+                        continue;
+                fprintf(fp, "\t%s", cache_name(dir));
+                if (dir == CC_MAX_AGE)
+                        fprintf(fp, ", %u", cc.max_age);
+                if (dir == CC_MAX_STALE && cc.max_stale != UINT32_MAX)
+                        fprintf(fp, ", %u", cc.max_stale);
+                if (dir == CC_MIN_FRESH)
+                        fprintf(fp, ", %u", cc.min_fresh);
+                if (dir == CC_S_MAXAGE)
+                        fprintf(fp, ", %u", cc.s_maxage);
+                if (dir == CC_NO_CACHE && cc.nocache_fields.len != 0)
+                        print_span(fp, req.text(cc.nocache_fields));
+                if (dir == CC_PRIVATE && cc.private_fields.len != 0)
+                        print_span(fp, req.text(cc.private_fields));
+                fprintf(fp, "\n");
         }
-        lex.skip(TOK_HTTP);
-        lex.skip(TOK_SLASH);
-        req.version = atof(lex.lex().c_str());
-        lex.skip(TOK_NUM);
-        lex.skip(TOK_EOL);
 
-        while (lex.type() != TOK_EOL) {
-                auto type = lex.type();
-                lex.skip(type);
-                lex.skip(TOK_COLON);
+        fprintf(fp, "Connection:\n");
+        fprintf(fp, "\t%s\n", req.connect.c_str());
 
-                if (type == TOK_CONTENT_LENGTH) {
-                        req.len = atoi(lex.lex().c_str());
-                        lex.skip(TOK_NUM);
-                } else if (type == TOK_ACCEPT) {
-                        while (lex.type() != TOK_EOL) {
-                                media m {"", "", 0};
-                                m.type = std::string{lex.lex()};
-                                lex.skip(TOK_WORD);
-                                lex.skip(TOK_SLASH);
-                                m.subtype = std::string{lex.lex()};
-                                lex.skip(TOK_WORD);
-                                if (lex.type() == TOK_SEMI) {
-                                        lex.skip(TOK_SEMI);
-                                        lex.skip(TOK_WORD);
-                                        lex.skip(TOK_EQ);
-                                        m.arg = atof(lex.lex().c_str());
-                                        lex.skip(TOK_NUM);
-                                }
-                                if (lex.type() == TOK_COMMA)
-                                        lex.skip(TOK_COMMA);
-                                req.accept.push_back(m);
-                        }
-                } else if (type == TOK_ACCEPT_CHARSET) {
-                        while (lex.type() != TOK_EOL) {
-                                charset set {"", 0};
-                                set.type = std::string{lex.lex()};
-                                lex.skip(TOK_WORD);
-                                if (lex.type() == TOK_SEMI) {
-                                        lex.skip(TOK_SEMI);
-                                        lex.skip(TOK_WORD);
-                                        lex.skip(TOK_EQ);
-                                        set.arg = atof(lex.lex().c_str());
-                                        lex.skip(TOK_NUM);
-                                }
-                                if (lex.type() == TOK_COMMA)
-                                        lex.skip(TOK_COMMA);
-                                req.charsets.push_back(set);
-                        }
-                } else if (type == TOK_ACCEPT_ENCODING) {
-                        while (lex.type() != TOK_EOL) {
-                                encoding e {"", 0};
-                                e.type = std::string{lex.lex()};
-                                lex.skip(TOK_WORD);
-                                if (lex.type() == TOK_SEMI) {
-                                        lex.skip(TOK_SEMI);
-                                        lex.skip(TOK_WORD);
-                                        lex.skip(TOK_EQ);
-                                        e.arg = atof(lex.lex().c_str());
-                                        lex.skip(TOK_NUM);
-                                }
-                                if (lex.type() == TOK_COMMA)
-                                        lex.skip(TOK_COMMA);
-                                req.encodings.push_back(e);
-                        }
-                } else if (type == TOK_ACCEPT_LANGUAGE) {
-                        while (lex.type() != TOK_EOL) {
-                                language l {"", 0};
-                                l.type = std::string{lex.lex()};
-                                lex.skip(TOK_WORD);
-                                if (lex.type() == TOK_SEMI) {
-                                        lex.skip(TOK_SEMI);
-                                        lex.skip(TOK_WORD);
-                                        lex.skip(TOK_EQ);
-                                        l.arg = atof(lex.lex().c_str());
-                                        lex.skip(TOK_NUM);
-                                }
-                                if (lex.type() == TOK_COMMA)
-                                        lex.skip(TOK_COMMA);
-                                req.langs.push_back(l);
-                        }
-                } else if (type == TOK_AUTHORIZATION) {
-                        req.auth = std::string{lex.lex()};
-                        lex.skip(TOK_WORD);
-                } else if (type == TOK_CACHE_CONTROL) {
-                        cache_dir reqdir;
-                        reqdir.n_arg = 0;
-                        reqdir.s_arg = "";
-                        reqdir.type = std::string{lex.lex()};
-                        lex.skip(TOK_WORD);
-                        if (lex.type() == TOK_EQ) {
-                                lex.skip(TOK_EQ);
-                                if (lex.type() == TOK_NUM) {
-                                        reqdir.n_arg = atof(lex.lex().c_str());
-                                } else {
-                                        reqdir.s_arg = std::string{lex.lex()};
-                                }
-                                lex.skip(lex.type());
-                        }
+        fprintf(fp, "Content-Encoding:\n");
+        fprintf(fp, "\t%s\n", req.ctnt_encoding.c_str());
 
-                        cache_dir resdir;
-                        resdir.type = "";
-                        resdir.n_arg = 0;
-                        resdir.s_arg = "";
-                        if (lex.type() == TOK_COMMA) {
-                                lex.skip(TOK_COMMA);
-                                resdir.type = std::string{lex.lex()};
-                                lex.skip(TOK_WORD);
-                                if (lex.type() == TOK_EQ) {
-                                        lex.skip(TOK_EQ);
-                                        if (lex.type() == TOK_NUM) {
-                                                resdir.n_arg = atof(
-                                                        lex.lex().c_str());
-                                        } else {
-                                                resdir.s_arg = std::string{
-                                                        lex.lex()};
-                                        }
-                                        lex.skip(lex.type());
-                                }
-                        }
+        fprintf(fp, "Content-Language:\n");
+        for (const auto& l : req.ctnt_langs)
+                fprintf(fp, "\t%s\n", l.type.c_str());
 
-                        req.cache.resdir = resdir;
-                        req.cache.reqdir = reqdir;
-                } else if (type == TOK_CONNECTION) {
-                        req.connect = std::string{lex.lex()};
-                        lex.skip(TOK_WORD);
-                } else if (type == TOK_CONTENT_ENCODING) {
-                        req.ctnt_encoding = std::string{lex.lex()};
-                        lex.skip(TOK_WORD);
-                } else if (type == TOK_CONTENT_LANGUAGE) {
-                        while (lex.type() != TOK_EOL) {
-                                language lang {"", 0};
-                                lang.type = std::string{lex.lex()};
-                                req.ctnt_langs.push_back(lang);
-                                lex.skip(TOK_WORD);
-                                if (lex.type() == TOK_COMMA)
-                                        lex.skip(TOK_COMMA);
-                        }
-                } else if (type == TOK_CONTENT_MD5) {
-                        req.md5 = std::string{lex.lex()};
-                        lex.skip(TOK_WORD);
-                }
+        fprintf(fp, "Content-MD5:\n");
+        fprintf(fp, "\t%s\n", req.md5.c_str());
+
+        fprintf(fp, "Transfer-Encoding:\n");
+        for (const auto& e : req.transfer)
+                fprintf(fp, "\t%s\n", e.type.c_str());
 
-                lex.skip(TOK_EOL);
+        fprintf(fp, "Other:\n");
+        for (const auto& f : req.fields) {
+                if (f.id < FIELD_OTHER)
+                        continue;
+                auto name = req.text(f.name);
+                auto value = req.text(f.value);
+                fprintf(fp, "\t%.*s: %.*s\n", static_cast<int>(name.size()),
+                        name.data(), static_cast<int>(value.size()),
+                        value.data());
         }
+        return true;
+}
 
-        printf("method=%s\n", req.method.c_str());
-        printf("path=%s\n", req.path.c_str());
-        printf("version=%f\n", req.version);
-        printf("Content-Length: %d\n", req.len);
+static void print_or_die(const request& req)
+{
+        if (!print_request(stdout, req))
+                die(req.src->error());
+}
 
-        printf("Accept:\n");
-        for (auto m : req.accept) {
-                printf("\t%s, %s, %f\n", m.type.c_str(),
-                                m.subtype.c_str(), m.arg);
-        }
+/* with -b, one per thread; a piece of a batch is flushed as it ends */
+static thread_local column_writer columns;
 
-        printf("Accept-Charset:\n");
-        for (auto s : req.charsets)
-                printf("\t%s, %f\n", s.type.c_str(), s.arg);
+static bool write_columns(FILE *fp, const request& req)
+{
+        if (!columns.add(fp, req)) {
+                if (ferror(fp))
+                        err(EX_IOERR, "write");
+                return false;
+        }
+        return true;
+}
 
-        printf("Accept-Encoding:\n");
-        for (auto e : req.encodings)
-                printf("\t%s, %f\n", e.type.c_str(), e.arg);
+static void flush_columns(FILE *fp)
+{
+        if (!columns.flush(fp))
+                err(EX_IOERR, "write");
+}
 
-        printf("Accept-Language:\n");
-        for (auto l : req.langs)
-                printf("\t%s, %f\n", l.type.c_str(), l.arg);
+/*
+ * how much of a mapped file is handed to the parser at a time; the
+ * pages of each window are dropped once it has been parsed.
+ */
+static const size_t WINDOW {16 * 1024 * 1024};
 
-        printf("Authorization:\n\t%s\n", req.auth.c_str());
+static std::string slurp(int fd)
+{
+        std::string s;
+        char buf[BUFSIZ];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0)
+                s.append(buf, n);
+        if (n < 0)
+                err(EX_IOERR, "read");
+        return s;
+}
 
-        printf("Cache-Control:\n");
-        auto type = req.cache.reqdir.type;
-        printf("\t%s", type.c_str());
-        std::unordered_set<std::string> reqdirmap {
-                "no-cache",
-                "no-store",
-                "max-age",
-                "max-stale",
-                "min-fresh",
-                "no-transform",
-                "only-if-cached",
-        };
-        auto p = reqdirmap.find(type);
-        if (p != reqdirmap.end()) {
-                if (type == "max-age" || type == "min-fresh")
-                        printf(", %f", req.cache.reqdir.n_arg);
-                if (type == "max-stale" && req.cache.reqdir.n_arg != 0)
-                        printf(", %f", req.cache.reqdir.n_arg);
-        } else {
-                if (req.cache.reqdir.s_arg.size() != 0)
-                        printf(", %s", req.cache.reqdir.s_arg.c_str());
-                if (req.cache.reqdir.n_arg != 0)
-                        printf(", %f", req.cache.reqdir.n_arg);
+int main(int argc, char **argv)
+{
+        auto lazy = false;
+        auto binary = false;
+        auto threads = 0;
+        int c;
+        while ((c = getopt(argc, argv, "blj:")) != -1) {
+                switch (c) {
+                case 'b':
+                        binary = true;
+                        break;
+                case 'l':
+                        lazy = true;
+                        break;
+                case 'j':
+                        threads = atoi(optarg);
+                        break;
+                default:
+                        usage("usage: %s [-bl] [-j threads] [file]",
+                            argv[0]);
+                }
         }
-        printf("\n");
 
-        type = req.cache.resdir.type;
-        printf("\t%s", type.c_str());
-        std::unordered_set<std::string> resdirmap {
-                "public",
-                "private",
-                "no-cache",
-                "no-store",
-                "no-transform",
-                "must-revalidate",
-                "proxy-revalidate",
-                "max-age",
-                "s-maxage",
+        mapped_file map;
+        auto mapped = optind < argc;
+        if (mapped && !map.open(argv[optind]))
+                err(EX_NOINPUT, "%s", argv[optind]);
+
+        if (threads > 0) {
+                std::string in;
+                if (!mapped)
+                        in = slurp(STDIN_FILENO);
+                auto data = mapped ? map.data() : in.data();
+                auto len = mapped ? map.size() : in.size();
+                parse_error e;
+                auto ok = binary ?
+                        batch_parse(data, len, threads, lazy, write_columns,
+                                stdout, nullptr, &e, flush_columns) :
+                        batch_parse(data, len, threads, lazy, print_request,
+                                stdout, nullptr, &e);
+                if (!ok)
+                        die(e);
+                return 0;
+        }
 
-        };
-        p = resdirmap.find(type);
-        if (p != resdirmap.end()) {
-                if (type == "max-age" || type == "s-maxage")
-                        printf(", %f", req.cache.resdir.n_arg);
-                if ((type == "private" || type == "no-cache") &&
-                        req.cache.resdir.s_arg.size() != 0) {
-                        printf(", %s", req.cache.resdir.s_arg.c_str());
+        request_cb cb = print_or_die;
+        if (binary) {
+                cb = [](const request& req) {
+                        if (!write_columns(stdout, req))
+                                die(req.src->error());
+                };
+        }
+        parser p {cb, lazy};
+        if (mapped) {
+                for (size_t off = 0; off < map.size(); off += WINDOW) {
+                        auto n = map.size() - off < WINDOW ?
+                                map.size() - off : WINDOW;
+                        if (p.feed(map.data() + off, n) == PARSE_ERROR)
+                                die(p.error());
+                        map.done(off + n);
                 }
         } else {
-                if (req.cache.resdir.s_arg.size() != 0)
-                        printf(", %s", req.cache.resdir.s_arg.c_str());
-                if (req.cache.resdir.n_arg != 0)
-                        printf(", %f", req.cache.resdir.n_arg);
+                char buf[BUFSIZ];
+                ssize_t n;
+                while ((n = read(STDIN_FILENO, buf, sizeof(buf))) > 0) {
+                        if (p.feed(buf, n) == PARSE_ERROR)
+                                die(p.error());
+                }
         }
-        printf("\n");
-
-        printf("Connection:\n");
-        printf("\t%s\n", req.connect.c_str());
-
-        printf("Content-Encoding:\n");
-        printf("\t%s\n", req.ctnt_encoding.c_str());
-
-        printf("Content-Language:\n");
-        for (auto l : req.ctnt_langs)
-                printf("\t%s\n", l.type.c_str());
-
-        printf("Content-MD5:\n");
-        printf("\t%s\n", req.md5.c_str());
+        if (p.pending() != 0)
+                usage("incomplete request");
+        if (binary)
+                flush_columns(stdout);
 }
@@ -0,0 +1,82 @@
+#include "mapfile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::~mapped_file(void)
+{
+        close();
+}
+
+/*
+ * map path, telling the kernel it will be read front to back so it
+ * reads ahead aggressively. false with errno set on failure.
+ */
+bool mapped_file::open(const char *path)
+{
+        close();
+
+        auto fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+                return false;
+
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+                ::close(fd);
+                return false;
+        }
+
+        _len = st.st_size;
+        if (_len == 0) {
+                ::close(fd);
+                return true;
+        }
+
+        auto p = mmap(nullptr, _len, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+                _len = 0;
+                return false;
+        }
+
+        madvise(p, _len, MADV_SEQUENTIAL);
+        _data = static_cast<const char *>(p);
+        _dropped = 0;
+        return true;
+}
+
+/*
+ * nothing before off will be looked at again: let the kernel drop
+ * those pages so a long replay keeps a small resident set.
+ */
+void mapped_file::done(size_t off)
+{
+        auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        auto end = off / page * page;
+        if (_data == nullptr || end <= _dropped || end > _len)
+                return;
+
+        madvise(const_cast<char *>(_data) + _dropped, end - _dropped,
+                MADV_DONTNEED);
+        _dropped = end;
+}
+
+void mapped_file::close(void)
+{
+        if (_data != nullptr)
+                munmap(const_cast<char *>(_data), _len);
+        _data = nullptr;
+        _len = 0;
+        _dropped = 0;
+}
+
+const char *mapped_file::data(void) const
+{
+        return _data;
+}
+
+size_t mapped_file::size(void) const
+{
+        return _len;
+}
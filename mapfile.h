@@ -0,0 +1,27 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <cstddef>
+
+/*
+ * a whole file mapped read-only for sequential lexing. lexemes taken
+ * from it stay valid for as long as the mapping does.
+ */
+class mapped_file {
+private:
+        const char *_data {nullptr};
+        size_t _len {0};
+        size_t _dropped {0};
+public:
+        mapped_file(void) = default;
+        ~mapped_file(void);
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        bool open(const char *path);
+        void done(size_t off);
+        void close(void);
+        const char *data(void) const;
+        size_t size(void) const;
+};
+
+#endif
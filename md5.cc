@@ -0,0 +1,121 @@
+#include "md5.h"
+#include <cstring>
+
+/* per-round shifts and the sines of RFC 1321, section 3.4 */
+static const unsigned char S[64] {
+        7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+        5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+        4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+        6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+static const uint32_t K[64] {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+        0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+        0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+        0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+        0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+        0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+        0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+        0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+        0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+md5::md5(void)
+        : _h {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476}
+{
+}
+
+static uint32_t rotl(uint32_t x, unsigned n)
+{
+        return x << n | x >> (32 - n);
+}
+
+void md5::block(const unsigned char *p)
+{
+        uint32_t m[16];
+        for (size_t i = 0; i < 16; i++) {
+                m[i] = uint32_t{p[i * 4]} | uint32_t{p[i * 4 + 1]} << 8 |
+                        uint32_t{p[i * 4 + 2]} << 16 |
+                        uint32_t{p[i * 4 + 3]} << 24;
+        }
+
+        auto a = _h[0], b = _h[1], c = _h[2], d = _h[3];
+        for (size_t i = 0; i < 64; i++) {
+                uint32_t f;
+                size_t g;
+                if (i < 16) {
+                        f = (b & c) | (~b & d);
+                        g = i;
+                } else if (i < 32) {
+                        f = (d & b) | (~d & c);
+                        g = (5 * i + 1) & 15;
+                } else if (i < 48) {
+                        f = b ^ c ^ d;
+                        g = (3 * i + 5) & 15;
+                } else {
+                        f = c ^ (b | ~d);
+                        g = (7 * i) & 15;
+                }
+                f += a + K[i] + m[g];
+                a = d;
+                d = c;
+                c = b;
+                b += rotl(f, S[i]);
+        }
+        _h[0] += a;
+        _h[1] += b;
+        _h[2] += c;
+        _h[3] += d;
+}
+
+/*
+ * whole blocks are hashed straight from p; only a partial one at
+ * either end goes through _buf
+ */
+void md5::update(const char *p, size_t n)
+{
+        auto in = reinterpret_cast<const unsigned char *>(p);
+        auto have = static_cast<size_t>(_len & 63);
+        _len += n;
+        if (have != 0) {
+                auto take = n < 64 - have ? n : 64 - have;
+                memcpy(_buf + have, in, take);
+                in += take;
+                n -= take;
+                if (have + take < 64)
+                        return;
+                block(_buf);
+        }
+        for (; n >= 64; in += 64, n -= 64)
+                block(in);
+        memcpy(_buf, in, n);
+}
+
+/*
+ * pad out the last block and write the digest. the hash is spent
+ * afterwards.
+ */
+void md5::digest(unsigned char out[SIZE])
+{
+        auto bits = _len * 8;
+        unsigned char pad[72] {0x80};
+        auto have = static_cast<size_t>(_len & 63);
+        auto n = (have < 56 ? 56 : 120) - have;
+        for (size_t i = 0; i < 8; i++)
+                pad[n + i] = static_cast<unsigned char>(bits >> i * 8);
+        update(reinterpret_cast<const char *>(pad), n + 8);
+
+        for (size_t i = 0; i < 4; i++) {
+                for (size_t j = 0; j < 4; j++)
+                        out[i * 4 + j] = static_cast<unsigned char>(
+                                _h[i] >> j * 8);
+        }
+}
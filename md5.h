@@ -0,0 +1,24 @@
+#ifndef MD5_H
+#define MD5_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * MD5 (RFC 1321) over data that arrives a piece at a time, as
+ * Content-MD5 needs. it checks for accidents, not tampering.
+ */
+class md5 {
+private:
+        uint32_t _h[4];
+        uint64_t _len {0};
+        unsigned char _buf[64];
+        void block(const unsigned char *p);
+public:
+        static const size_t SIZE {16};
+        md5(void);
+        void update(const char *p, size_t n);
+        void digest(unsigned char out[SIZE]);
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "names.h"
+#include <strings.h>
+
+static uint32_t hash(const char *p, size_t n)
+{
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < n; i++) {
+                auto c = static_cast<unsigned char>(p[i]);
+                if (c >= 'A' && c <= 'Z')
+                        c |= 0x20;
+                h = (h ^ c) * 16777619u;
+        }
+        return h;
+}
+
+/*
+ * the slot holding the name, or the empty one where it would go
+ */
+size_t name_table::find_slot(const char *p, size_t n, uint32_t h) const
+{
+        auto mask = _slots.size() - 1;
+        for (auto i = h & mask; ; i = (i + 1) & mask) {
+                auto& s = _slots[i];
+                if (s.len == 0)
+                        return i;
+                if (s.hash == h && s.len == n &&
+                    strncasecmp(_pool.data() + s.off, p, n) == 0)
+                        return i;
+        }
+}
+
+/*
+ * double the slots, keeping them at most half full
+ */
+void name_table::grow(void)
+{
+        std::vector<slot> old;
+        old.swap(_slots);
+        _slots.assign(old.empty() ? 64 : old.size() * 2, slot{0, 0, 0, 0});
+        for (const auto& s : old) {
+                if (s.len == 0)
+                        continue;
+                auto i = find_slot(_pool.data() + s.off, s.len, s.hash);
+                _slots[i] = s;
+                _byid[s.id - FIELD_FIRST] = i;
+        }
+}
+
+int name_table::intern(const char *p, size_t n)
+{
+        if (n == 0)
+                return FIELD_OTHER;
+        if (_slots.empty())
+                grow();
+
+        auto h = hash(p, n);
+        auto i = find_slot(p, n, h);
+        if (_slots[i].len != 0)
+                return _slots[i].id;
+        if (_byid.size() == MAX)
+                return FIELD_OTHER;
+
+        uint32_t off = _pool.size();
+        for (size_t j = 0; j < n; j++) {
+                auto c = p[j];
+                _pool += static_cast<char>(c >= 'A' && c <= 'Z' ?
+                        c | 0x20 : c);
+        }
+        uint32_t id = FIELD_FIRST + _byid.size();
+        _slots[i] = slot{h, off, static_cast<uint32_t>(n), id};
+        _byid.push_back(i);
+        if (_byid.size() * 2 > _slots.size())
+                grow();
+        return id;
+}
+
+/*
+ * the id of a name already interned, or -1
+ */
+int name_table::find(const char *p, size_t n) const
+{
+        if (_slots.empty() || n == 0)
+                return -1;
+        auto i = find_slot(p, n, hash(p, n));
+        return _slots[i].len == 0 ? -1 : _slots[i].id;
+}
+
+/*
+ * an interned name in lower case, empty for ids it didn't hand out
+ */
+span name_table::name(int id) const
+{
+        if (id < FIELD_FIRST ||
+            static_cast<size_t>(id - FIELD_FIRST) >= _byid.size())
+                return span{};
+        auto& s = _slots[_byid[id - FIELD_FIRST]];
+        return span{_pool.data() + s.off, s.len};
+}
+
+size_t name_table::size(void) const
+{
+        return _byid.size();
+}
+
+void name_table::clear(void)
+{
+        _slots.clear();
+        _byid.clear();
+        _pool.clear();
+}
@@ -0,0 +1,50 @@
+#ifndef NAMES_H
+#define NAMES_H
+
+#include "span.h"
+#include "token.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * ids for header names: a known header's id is its TOK_* value, an
+ * unknown one gets an id from the parser's name_table, and once the
+ * table is full the rest share FIELD_OTHER.
+ */
+enum {
+        FIELD_OTHER = TOK_COUNT,
+        FIELD_FIRST,
+};
+
+/*
+ * the unknown header names a parser has seen, interned for as long
+ * as the parser lives. names compare case-insensitively. looking up
+ * a name already in the table allocates nothing; a new name is
+ * copied once, in lower case, into a shared pool. the table stops
+ * growing at MAX names so a peer can't make it grow without bound.
+ */
+class name_table {
+private:
+        struct slot {
+                uint32_t hash;
+                uint32_t off;
+                uint32_t len;
+                uint32_t id;
+        };
+        std::vector<slot> _slots {};
+        std::vector<uint32_t> _byid {};
+        std::string _pool {};
+        size_t find_slot(const char *p, size_t n, uint32_t h) const;
+        void grow(void);
+public:
+        static const size_t MAX {1024};
+        int intern(const char *p, size_t n);
+        int find(const char *p, size_t n) const;
+        span name(int id) const;
+        size_t size(void) const;
+        void clear(void);
+};
+
+#endif
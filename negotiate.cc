@@ -0,0 +1,228 @@
+#include "negotiate.h"
+#include <strings.h>
+
+static bool same(const char *a, size_t alen, const char *b, size_t blen)
+{
+        return alen == blen && strncasecmp(a, b, alen) == 0;
+}
+
+static bool same(const astring& a, const char *b, size_t blen)
+{
+        return same(a.data(), a.size(), b, blen);
+}
+
+/*
+ * the offer with the highest q, first one on a tie. q(i) gives the
+ * q of offer i, or a negative value if nothing matched it.
+ */
+template <typename F>
+static int pick(const offers& o, F q)
+{
+        auto best = -1;
+        auto top = 0;
+        for (size_t i = 0; i < o.size(); i++) {
+                auto v = q(i);
+                if (v > top) {
+                        top = v;
+                        best = i;
+                }
+        }
+        return best;
+}
+
+/*
+ * type/subtype beats type/'*', which beats '*'/'*'
+ */
+int negotiate_media(const request& req, const offers& o)
+{
+        if (!req.load(TOK_ACCEPT))
+                return -1;
+        if (!req.has(TOK_ACCEPT))
+                return o.empty() ? -1 : 0;
+
+        return pick(o, [&](size_t i) {
+                auto& off = o[i];
+                auto slash = off.find('/');
+                if (slash == std::string::npos)
+                        return -1;
+                auto sub = off.c_str() + slash + 1;
+                auto sublen = off.size() - slash - 1;
+
+                auto rank = -1;
+                int q = -1;
+                for (const auto& m : req.accept) {
+                        int r;
+                        if (m.type == "*" && m.subtype == "*")
+                                r = 0;
+                        else if (!same(m.type, off.c_str(), slash))
+                                continue;
+                        else if (m.subtype == "*")
+                                r = 1;
+                        else if (same(m.subtype, sub, sublen))
+                                r = 2;
+                        else
+                                continue;
+                        if (r > rank) {
+                                rank = r;
+                                q = m.q;
+                        }
+                }
+                return q;
+        });
+}
+
+int negotiate_charset(const request& req, const offers& o)
+{
+        if (!req.load(TOK_ACCEPT_CHARSET))
+                return -1;
+        if (!req.has(TOK_ACCEPT_CHARSET))
+                return o.empty() ? -1 : 0;
+
+        return pick(o, [&](size_t i) {
+                int q = -1;
+                int any = -1;
+                for (const auto& c : req.charsets) {
+                        if (c.type == "*")
+                                any = c.q;
+                        else if (same(c.type, o[i].c_str(), o[i].size()))
+                                q = c.q;
+                }
+                return q < 0 ? any : q;
+        });
+}
+
+/*
+ * identity needs no mention to be acceptable: only an explicit
+ * identity;q=0, or '*';q=0 with no identity entry, rules it out.
+ */
+int negotiate_encoding(const request& req, const offers& o)
+{
+        if (!req.load(TOK_ACCEPT_ENCODING))
+                return -1;
+        if (!req.has(TOK_ACCEPT_ENCODING))
+                return o.empty() ? -1 : 0;
+
+        return pick(o, [&](size_t i) {
+                int q = -1;
+                int any = -1;
+                for (const auto& e : req.encodings) {
+                        if (e.type == "*")
+                                any = e.q;
+                        else if (same(e.type, o[i].c_str(), o[i].size()))
+                                q = e.q;
+                }
+                if (q < 0)
+                        q = any;
+                if (q < 0 && same(o[i].c_str(), o[i].size(), "identity", 8))
+                        q = 1000;
+                return q;
+        });
+}
+
+/*
+ * a range matches a tag equal to it or starting with it and a '-',
+ * as in RFC 4647 basic filtering; the longest matching range counts.
+ */
+int negotiate_language(const request& req, const offers& o)
+{
+        if (!req.load(TOK_ACCEPT_LANGUAGE))
+                return -1;
+        if (!req.has(TOK_ACCEPT_LANGUAGE))
+                return o.empty() ? -1 : 0;
+
+        return pick(o, [&](size_t i) {
+                auto& tag = o[i];
+                size_t longest = 0;
+                int q = -1;
+                for (const auto& l : req.langs) {
+                        size_t n;
+                        if (l.type == "*") {
+                                n = 0;
+                        } else if (l.type.size() <= tag.size() &&
+                            strncasecmp(l.type.data(), tag.data(),
+                                l.type.size()) == 0 &&
+                            (l.type.size() == tag.size() ||
+                             tag[l.type.size()] == '-')) {
+                                n = l.type.size();
+                        } else {
+                                continue;
+                        }
+                        if (q < 0 || n > longest) {
+                                longest = n;
+                                q = l.q;
+                        }
+                }
+                return q;
+        });
+}
+
+negotiator::negotiator(size_t cap)
+        : _cap {cap ? cap : 1}
+{
+}
+
+int negotiator::match(const request& req, int hdr, const offers& o) const
+{
+        switch (hdr) {
+        case TOK_ACCEPT:
+                return negotiate_media(req, o);
+        case TOK_ACCEPT_CHARSET:
+                return negotiate_charset(req, o);
+        case TOK_ACCEPT_ENCODING:
+                return negotiate_encoding(req, o);
+        case TOK_ACCEPT_LANGUAGE:
+                return negotiate_language(req, o);
+        }
+        return -1;
+}
+
+/*
+ * the key is the header, the offers one per line, a blank line and
+ * then the raw value. _key keeps its capacity, so a hit costs no
+ * allocation once it has grown.
+ */
+int negotiator::best(const request& req, int hdr, const offers& o)
+{
+        if (!req.has(hdr) || (req.repeated & uint64_t{1} << hdr))
+                return match(req, hdr, o);
+
+        auto v = req.value(hdr);
+        _key.assign(1, static_cast<char>(hdr));
+        for (const auto& s : o) {
+                _key += s;
+                _key += '\n';
+        }
+        _key += '\n';
+        _key.append(v.data(), v.size());
+
+        auto it = _map.find(_key);
+        if (it != _map.end()) {
+                _hits++;
+                _lru.splice(_lru.begin(), _lru, it->second.age);
+                return it->second.best;
+        }
+
+        _misses++;
+        auto best = match(req, hdr, o);
+        if (best < 0 && !req.load(hdr))
+                return best;
+
+        if (_map.size() == _cap) {
+                _map.erase(_map.find(*_lru.back()));
+                _lru.pop_back();
+        }
+        auto ins = _map.emplace(_key, slot{best, _lru.end()});
+        _lru.push_front(&ins.first->first);
+        ins.first->second.age = _lru.begin();
+        return best;
+}
+
+size_t negotiator::hits(void) const
+{
+        return _hits;
+}
+
+size_t negotiator::misses(void) const
+{
+        return _misses;
+}
@@ -0,0 +1,63 @@
+#ifndef NEGOTIATE_H
+#define NEGOTIATE_H
+
+#include "request.h"
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * the variants a resource can be sent as, in the server's order of
+ * preference: "type/subtype" media types, language tags, content
+ * codings or charsets, depending on what is being negotiated.
+ */
+typedef std::vector<std::string> offers;
+
+/*
+ * pick the offer a request's Accept-* header likes best, by RFC 7231:
+ * the most specific range that matches an offer gives it its q, an
+ * offer whose q is 0 is never picked, and ties go to the earlier
+ * offer. each returns an index into the offers, or -1 when none is
+ * acceptable or the header fails to parse. without the header any
+ * offer will do; identity is acceptable unless refused outright.
+ */
+int negotiate_media(const request& req, const offers& o);
+int negotiate_charset(const request& req, const offers& o);
+int negotiate_encoding(const request& req, const offers& o);
+int negotiate_language(const request& req, const offers& o);
+
+/*
+ * negotiation with the answers remembered. clients send the same few
+ * Accept-* values over and over, so results are kept in an LRU of
+ * bounded size keyed on the header's raw bytes and the offers; a hit
+ * neither parses the header, when the parser is lazy, nor matches.
+ * headers sent more than once bypass the cache, since only the first
+ * value's bytes are indexed.
+ *
+ * hdr is one of TOK_ACCEPT, TOK_ACCEPT_CHARSET, TOK_ACCEPT_ENCODING
+ * and TOK_ACCEPT_LANGUAGE. -1 also comes back if the header fails to
+ * parse. not thread safe; keep one per thread.
+ */
+class negotiator {
+private:
+        struct slot {
+                int best;
+                std::list<const std::string *>::iterator age;
+        };
+        std::unordered_map<std::string, slot> _map {};
+        std::list<const std::string *> _lru {};
+        std::string _key {};
+        size_t _cap;
+        size_t _hits {0};
+        size_t _misses {0};
+        int match(const request& req, int hdr, const offers& o) const;
+public:
+        negotiator(size_t cap = 1024);
+        int best(const request& req, int hdr, const offers& o);
+        size_t hits(void) const;
+        size_t misses(void) const;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "number.h"
+
+static bool digit(char c)
+{
+        return c >= '0' && c <= '9';
+}
+
+/*
+ * "0" or "1", then optionally a dot and up to three digits, which
+ * must all be 0 after a 1
+ */
+bool parse_qvalue(span s, uint16_t *out)
+{
+        auto p = s.data();
+        auto n = s.size();
+        if (n == 0 || n > 5 || (p[0] != '0' && p[0] != '1'))
+                return false;
+        if (n > 1 && p[1] != '.')
+                return false;
+
+        unsigned q = p[0] - '0';
+        size_t i = 2;
+        for (; i < n; i++) {
+                if (!digit(p[i]))
+                        return false;
+                q = q * 10 + (p[i] - '0');
+        }
+        for (; i < 5; i++)
+                q *= 10;
+        if (q > 1000)
+                return false;
+        *out = q;
+        return true;
+}
+
+bool parse_u64(span s, uint64_t *out)
+{
+        auto p = s.data();
+        if (s.empty())
+                return false;
+
+        uint64_t v = 0;
+        for (size_t i = 0; i < s.size(); i++) {
+                if (!digit(p[i]))
+                        return false;
+                unsigned d = p[i] - '0';
+                if (v > (UINT64_MAX - d) / 10)
+                        return false;
+                v = v * 10 + d;
+        }
+        *out = v;
+        return true;
+}
+
+bool parse_delta(span s, uint32_t *out)
+{
+        static const uint32_t MAX_DELTA {uint32_t{1} << 31};
+        auto p = s.data();
+        if (s.empty())
+                return false;
+
+        uint64_t v = 0;
+        for (size_t i = 0; i < s.size(); i++) {
+                if (!digit(p[i]))
+                        return false;
+                if (v < MAX_DELTA)
+                        v = v * 10 + (p[i] - '0');
+        }
+        *out = v < MAX_DELTA ? v : MAX_DELTA;
+        return true;
+}
+
+bool parse_version(span s, uint8_t *major, uint8_t *minor)
+{
+        auto p = s.data();
+        if (s.size() != 3 || !digit(p[0]) || p[1] != '.' || !digit(p[2]))
+                return false;
+        *major = p[0] - '0';
+        *minor = p[2] - '0';
+        return true;
+}
@@ -0,0 +1,26 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include "span.h"
+#include <cstdint>
+
+/*
+ * numbers read straight from token bytes: no copy, no locale, no
+ * floating point. each takes the whole span, returns false if it is
+ * not a valid number of its kind or does not fit, and leaves *out
+ * alone in that case.
+ */
+
+/* a q-value in thousandths, 0 to 1000 */
+bool parse_qvalue(span s, uint16_t *out);
+
+/* a decimal count such as Content-Length */
+bool parse_u64(span s, uint64_t *out);
+
+/* delta-seconds; too large a value means 2^31, per RFC 7234 */
+bool parse_delta(span s, uint32_t *out);
+
+/* the digits of HTTP/x.y */
+bool parse_version(span s, uint8_t *major, uint8_t *minor);
+
+#endif
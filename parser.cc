@@ -0,0 +1,771 @@
+#include "parser.h"
+#include "header.h"
+#include "number.h"
+#include "path.h"
+#include "scan.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <strings.h>
+#include <utility>
+
+parser::parser(request_cb cb, bool lazy)
+        : _cb {cb},
+        _lazy {lazy}
+{
+}
+
+/*
+ * with nothing held over from earlier calls the input is parsed
+ * where it lies and only the unfinished tail is copied. while
+ * something is held, the input goes in a line at a time, body bytes
+ * going straight out, until the held request no longer needs its
+ * bytes; the rest is then parsed in place too. so a request split
+ * across calls costs a copy of itself, never of what follows it.
+ */
+int parser::feed(const char *buf, size_t len)
+{
+        while (_state == PARSE_NEED_MORE && _len != 0 && len != 0) {
+                size_t n;
+                if (in_data() && _line == _len) {
+                        n = static_cast<size_t>(std::min<uint64_t>(_left,
+                                len));
+                        if (_body && n != 0)
+                                _body(_req, buf, n);
+                        _left -= n;
+                        _base += n;
+                } else {
+                        auto lf = static_cast<const char *>(
+                                memchr(buf, '\n', len));
+                        n = lf == nullptr ? len : lf - buf + 1;
+                        _buf.append(buf, n);
+                        _data = _buf.data();
+                        _len = _buf.size();
+                        _req.raw = _data + _start;
+                }
+                buf += n;
+                len -= n;
+                run();
+                keep();
+        }
+        if (_state == PARSE_ERROR || len == 0)
+                return _state;
+
+        if (_len == 0 && _state == PARSE_NEED_MORE) {
+                _data = buf;
+                _len = len;
+        } else {
+                _buf.append(buf, len);
+                _data = _buf.data();
+                _len = _buf.size();
+        }
+
+        _req.raw = _data + _start;
+        if (_state != PARSE_DONE)
+                run();
+        keep();
+        return _state;
+}
+
+/*
+ * move past a request the caller got PARSE_DONE for and go on with
+ * its body and whatever was pipelined behind it.
+ */
+int parser::next(void)
+{
+        if (_state != PARSE_DONE)
+                return _state;
+
+        _state = PARSE_NEED_MORE;
+        if (_phase == PHASE_HEAD)
+                start_next();
+        run();
+        keep();
+        return _state;
+}
+
+int parser::run(void)
+{
+        for (;;) {
+                if (in_data()) {
+                        auto n = static_cast<size_t>(std::min<uint64_t>(
+                                _left, _len - _line));
+                        if (_body && n != 0)
+                                _body(_req, _data + _line, n);
+                        _left -= n;
+                        _line = _scan = _line + n;
+                        if (_left != 0)
+                                return _state;
+                        if (_phase == PHASE_BODY) {
+                                body_done();
+                                continue;
+                        }
+                        _phase = PHASE_CHUNK_END;
+                }
+
+                auto cr = _scan + scan_byte(_data + _scan, _len - _scan,
+                        '\r');
+                auto from = _phase == PHASE_HEAD ? _start : _line;
+                if (cr - from > _max_head) {
+                        fail(ERR_TOO_LONG, _base + from + _max_head);
+                        return _state;
+                }
+                if (cr == _len) {
+                        _scan = cr;
+                        return _state;
+                }
+
+                if (cr + 1 == _len) {
+                        /* look at the \r again once its \n arrives */
+                        _scan = cr;
+                        return _state;
+                }
+                if (_data[cr + 1] != '\n') {
+                        _err = parse_error{ERR_CRLF, _base + cr,
+                                TOK_EOF, TOK_EOF};
+                        return _state = PARSE_ERROR;
+                }
+
+                auto len = cr + 2 - _line;
+                auto end = false;
+                switch (_phase) {
+                case PHASE_HEAD:
+                        parse_line(len);
+                        break;
+                case PHASE_CHUNK_SIZE:
+                        parse_chunk(len);
+                        break;
+                case PHASE_CHUNK_END:
+                        if (len != 2)
+                                fail(ERR_CHUNK, _base + _line);
+                        _phase = PHASE_CHUNK_SIZE;
+                        break;
+                case PHASE_TRAILER:
+                        /* trailer fields are read past, not kept */
+                        end = len == 2;
+                        break;
+                }
+                _line = _scan = cr + 2;
+                _req.raw = _data + _start;
+
+                if (end) {
+                        body_done();
+                        continue;
+                }
+                if (_state == PARSE_DONE) {
+                        head_done();
+                        if (_state != PARSE_NEED_MORE)
+                                return _state;
+                        continue;
+                }
+                if (_state != PARSE_NEED_MORE)
+                        return _state;
+        }
+}
+
+void parser::start_next(void)
+{
+        STAT_REQUEST(true);
+        _req.clear();
+        _arena.reset();
+        _start = _line;
+        _reqoff = _base + _start;
+        _phase = PHASE_HEAD;
+        _state = PARSE_NEED_MORE;
+        _first = true;
+}
+
+/*
+ * hold on to the bytes of the current request, which the caller's
+ * buffer can't be trusted with past this call, and drop those of
+ * requests that are already finished. once the head is read only it
+ * and the unread tail are kept; body bytes already handed out go.
+ * the buffer keeps its capacity, so a connection stops allocating
+ * once it has seen its largest request head.
+ */
+void parser::keep(void)
+{
+        if (_state == PARSE_ERROR)
+                return;
+
+        auto gap = _phase == PHASE_HEAD ? 0 : _line - _hend;
+        if (_data != _buf.data() && gap == 0) {
+                _buf.assign(_data + _start, _len - _start);
+        } else if (_data != _buf.data()) {
+                _buf.assign(_data + _start, _hend - _start);
+                _buf.append(_data + _line, _len - _line);
+        } else {
+                if (gap != 0)
+                        _buf.erase(_hend, gap);
+                if (_start != 0)
+                        _buf.erase(0, _start);
+        }
+
+        _base += _start + gap;
+        _line -= _start + gap;
+        _scan -= _start + gap;
+        _hend = _phase == PHASE_HEAD ? 0 : _hend - _start;
+        _start = 0;
+        _data = _buf.data();
+        _len = _buf.size();
+        _req.raw = _data;
+}
+
+/*
+ * the blank line ending the head was just read. work out how the
+ * body is framed, then hand the request over: to the callback, or
+ * to the caller through PARSE_DONE.
+ */
+void parser::head_done(void)
+{
+        _hend = _line;
+        {
+                STAT_SCOPE(STAT_FRAMING, 0);
+                if (!load(TOK_TRANSFER_ENCODING) ||
+                    !load(TOK_CONTENT_LENGTH)) {
+                        _state = PARSE_ERROR;
+                        return;
+                }
+
+                if (!_req.transfer.empty()) {
+                        /* a request's body is only delimited by chunked */
+                        if (strcasecmp(_req.transfer.back().type.c_str(),
+                            "chunked") != 0) {
+                                fail(ERR_FRAMING, _reqoff + _req.fields[
+                                        _req.at[TOK_TRANSFER_ENCODING]]
+                                        .value.off);
+                                return;
+                        }
+                        _phase = PHASE_CHUNK_SIZE;
+                } else if (_req.len > 0) {
+                        _phase = PHASE_BODY;
+                        _left = _req.len;
+                }
+        }
+
+        if (!_cb)
+                return;
+        _state = PARSE_NEED_MORE;
+        _cb(_req);
+        if (_phase == PHASE_HEAD)
+                start_next();
+}
+
+void parser::body_done(void)
+{
+        if (_body)
+                _body(_req, nullptr, 0);
+        start_next();
+}
+
+void parser::fail(int code, size_t off)
+{
+        _err = parse_error{code, off, TOK_EOF, TOK_EOF};
+        _state = PARSE_ERROR;
+}
+
+bool parser::in_data(void) const
+{
+        return _phase == PHASE_BODY || _phase == PHASE_CHUNK_DATA;
+}
+
+/*
+ * a chunk size line: hex digits, then maybe extensions, which are
+ * ignored. the last chunk has size zero and trailers follow it.
+ */
+void parser::parse_chunk(size_t len)
+{
+        STAT_SCOPE(STAT_CHUNK, len);
+        auto p = _data + _line;
+        auto end = len - 2;
+        uint64_t n = 0;
+        size_t i = 0;
+
+        for (; i < end && isxdigit(static_cast<unsigned char>(p[i])); i++) {
+                if (n >> 60) {
+                        fail(ERR_CHUNK, _base + _line + i);
+                        return;
+                }
+                auto c = p[i] | 0x20;
+                n = n << 4 | (c <= '9' ? c - '0' : c - 'a' + 10);
+        }
+        /* the size has at least one digit, or it's no size at all */
+        if (i == 0) {
+                fail(ERR_CHUNK, _base + _line);
+                return;
+        }
+        while (i < end && (p[i] == ' ' || p[i] == '\t'))
+                i++;
+        if (i < end && p[i] != ';') {
+                fail(ERR_CHUNK, _base + _line + i);
+                return;
+        }
+
+        _phase = n == 0 ? PHASE_TRAILER : PHASE_CHUNK_DATA;
+        _left = n;
+}
+
+static void assign(astring& dst, span src)
+{
+        dst.assign(src.data(), src.size());
+}
+
+/*
+ * the current token through one of the number.h parsers. a number
+ * that doesn't parse fails at the token; anything but a number fails
+ * the skip.
+ */
+template <typename T>
+static void number(lexer& lex, bool (*conv)(span, T *), T *out)
+{
+        if (lex.type() == TOK_NUM && !conv(lex.lex(), out))
+                lex.reject(ERR_NUMBER);
+        lex.skip(TOK_NUM);
+}
+
+/* a directive's argument: a token or a quoted string */
+static void skip_arg(lexer& lex)
+{
+        auto t = lex.type();
+        lex.skip(t == TOK_WORD || t == TOK_NUM ? t : TOK_STR);
+}
+
+/*
+ * Cache-Control directives, into the request's bitset. a header sent
+ * twice adds to what the first one set.
+ */
+static void parse_cache(lexer& lex, request& req)
+{
+        auto& cc = req.cache;
+        while (lex.type() != TOK_EOL) {
+                auto name = lex.lex();
+                auto dir = cache_lookup(name.data(), name.size());
+                if (dir < 0)
+                        dir = CC_EXTENSION;
+                cc.dirs |= uint32_t{1} << dir;
+                lex.skip(TOK_WORD);
+
+                if (lex.type() != TOK_EQ) {
+                        if (dir == CC_MAX_STALE)
+                                cc.max_stale = UINT32_MAX;
+                } else {
+                        lex.skip(TOK_EQ);
+                        auto arg = lex.lex();
+                        rawhdr at {static_cast<uint32_t>(arg.data() - req.raw),
+                                static_cast<uint32_t>(arg.size())};
+                        switch (dir) {
+                        case CC_MAX_AGE:
+                                number(lex, parse_delta, &cc.max_age);
+                                break;
+                        case CC_MAX_STALE:
+                                number(lex, parse_delta, &cc.max_stale);
+                                break;
+                        case CC_MIN_FRESH:
+                                number(lex, parse_delta, &cc.min_fresh);
+                                break;
+                        case CC_S_MAXAGE:
+                                number(lex, parse_delta, &cc.s_maxage);
+                                break;
+                        case CC_NO_CACHE:
+                                cc.nocache_fields = at;
+                                skip_arg(lex);
+                                break;
+                        case CC_PRIVATE:
+                                cc.private_fields = at;
+                                skip_arg(lex);
+                                break;
+                        default:
+                                skip_arg(lex);
+                        }
+                }
+
+                if (lex.type() != TOK_EOL)
+                        lex.skip(TOK_COMMA);
+        }
+}
+
+void parser::parse_line(size_t len)
+{
+        /*
+         * an empty line where a request line should be, as some
+         * clients send after a body, is skipped (RFC 7230, 3.5)
+         */
+        if (_first && len == 2) {
+                _start = _line + len;
+                _reqoff = _base + _start;
+                return;
+        }
+        if (!_first && len == 2) {
+                _req.head = static_cast<uint32_t>(_line + len - _start);
+                _state = PARSE_DONE;
+                return;
+        }
+
+        STAT_SCOPE(_first ? STAT_REQLINE : STAT_HEADER, len);
+        _lex.reset(_data + _line, len,
+                _first ? LEX_REQLINE : LEX_HEADER);
+        _lex.next();
+        if (_first) {
+                _first = false;
+                parse_reqline();
+        } else {
+                parse_header(len);
+        }
+
+        if (_lex.error().code != ERR_NONE && _state != PARSE_ERROR) {
+                _err = _lex.error();
+                _err.off += _base + _line;
+                _state = PARSE_ERROR;
+        }
+}
+
+void parser::parse_reqline(void)
+{
+        _req.verb = method_lookup(_lex.lex().data(), _lex.lex().size());
+        assign(_req.method, _lex.lex());
+        _lex.next();
+        if (_lex.type() == TOK_PATH) {
+                auto t = _lex.curr();
+                auto base = static_cast<uint32_t>(_line - _start);
+                size_t q = t.len();
+                /* CONNECT names a host and port, not a resource */
+                auto ok = _req.verb == METHOD_CONNECT ?
+                        authority_form(_lex.lex()) :
+                        normalize_path(_lex.lex(), _req.path, &q);
+                if (!ok)
+                        _lex.reject(ERR_TARGET);
+                _req.target = rawhdr{base + static_cast<uint32_t>(t.off()),
+                        static_cast<uint32_t>(t.len())};
+                _req.query = rawhdr{_req.target.off +
+                        static_cast<uint32_t>(q),
+                        static_cast<uint32_t>(t.len() - q)};
+        }
+        _lex.skip(TOK_PATH);
+        _lex.skip(TOK_HTTP);
+        _lex.skip(TOK_SLASH);
+        if (_lex.type() == TOK_NUM &&
+            !parse_version(_lex.lex(), &_req.major, &_req.minor))
+                _lex.reject(ERR_NUMBER);
+        _lex.skip(TOK_NUM);
+        _lex.skip(TOK_EOL);
+}
+
+/*
+ * the name of a header line. every line goes into the request's
+ * field table; an unknown name is interned and its value left as it
+ * is, once it is known to hold no control characters. a known
+ * header's value is parsed right away unless the parser is lazy. a
+ * header sent twice is always parsed so both values end up in the
+ * request. a line that doesn't start with a name, known or not,
+ * fails with ERR_HEADER.
+ */
+void parser::parse_header(size_t len)
+{
+        auto type = _lex.type();
+        auto name = _lex.curr();
+        if (type != TOK_FIELD && !header_known(type)) {
+                _lex.reject(ERR_HEADER);
+                return;
+        }
+        _lex.skip(type);
+        if (_lex.type() != TOK_COLON) {
+                _lex.skip(TOK_COLON);
+                return;
+        }
+
+        auto line = _data + _line;
+        auto off = _lex.curr().off() + 1;
+        while (off < len - 2 && line[off] == ' ')
+                off++;
+        /*
+         * values that aren't lexed now, unknown ones or any when lazy,
+         * still may not carry control characters (RFC 7230, 3.2.4):
+         * a bare LF or a NUL passed on could split the line downstream
+         */
+        auto ctl = off + scan_ctl(line + off, len - 2 - off);
+        if (ctl != len - 2) {
+                fail(ERR_CHAR, _base + _line + ctl);
+                return;
+        }
+        auto base = static_cast<uint32_t>(_line - _start);
+        field f {static_cast<uint32_t>(type),
+                {base + static_cast<uint32_t>(name.off()),
+                        static_cast<uint32_t>(name.len())},
+                {base + static_cast<uint32_t>(off),
+                        static_cast<uint32_t>(len - 2 - off)}};
+
+        /* most requests fit, so the table is rarely copied as it grows */
+        if (_req.fields.capacity() == 0)
+                _req.fields.reserve(16);
+        if (type == TOK_FIELD) {
+                f.id = _names.intern(line + name.off(), name.len());
+                _req.fields.push_back(f);
+                return;
+        }
+
+        auto bit = uint64_t{1} << type;
+        auto dup = (_req.seen & bit) && !(_req.parsed & bit);
+        if (_req.seen & bit)
+                _req.repeated |= bit;
+        else
+                _req.at[type] = _req.fields.size();
+        _req.seen |= bit;
+        _req.fields.push_back(f);
+        if (_lazy && !dup)
+                return;
+        if (dup)
+                parse_value(type, _req.fields[_req.at[type]].value);
+        if (_state != PARSE_ERROR)
+                parse_value(type, f.value);
+}
+
+/*
+ * parse one recorded value into the request's fields. values are
+ * followed by their CRLF in the buffer, which ends the lexing.
+ */
+void parser::parse_value(int type, const rawhdr& h)
+{
+        STAT_SCOPE(STAT_VALUE, h.len, type);
+        if (type == TOK_CONTENT_MD5) {
+                /* base64 has '+', '/' and '=', so the value isn't lexed */
+                auto v = _data + _start + h.off;
+                auto n = h.len;
+                while (n > 0 && (v[n - 1] == ' ' || v[n - 1] == '\t'))
+                        n--;
+                _req.md5.assign(v, n);
+                _req.parsed |= uint64_t{1} << type;
+                return;
+        }
+        _lex.reset(_data + _start + h.off, h.len + 2, LEX_VALUE);
+        _lex.next();
+        parse_fields(type);
+        _req.parsed |= uint64_t{1} << type;
+
+        if (_lex.error().code != ERR_NONE) {
+                _req.bad |= uint64_t{1} << type;
+                _err = _lex.error();
+                _err.off += _reqoff + h.off;
+                _state = PARSE_ERROR;
+        }
+}
+
+void parser::parse_fields(int type)
+{
+        if (type == TOK_CONTENT_LENGTH) {
+                /* lengths that disagree leave the framing in doubt */
+                auto again = _req.parsed & uint64_t{1} << type;
+                auto prev = _req.len;
+                number(_lex, parse_u64, &_req.len);
+                if (again && _req.len != prev)
+                        _lex.reject(ERR_FRAMING);
+        } else if (type == TOK_ACCEPT) {
+                while (_lex.type() != TOK_EOL) {
+                        media m {_req.str(), _req.str(), 1000};
+                        assign(m.type, _lex.lex());
+                        _lex.skip(TOK_WORD);
+                        _lex.skip(TOK_SLASH);
+                        assign(m.subtype, _lex.lex());
+                        _lex.skip(TOK_WORD);
+                        if (_lex.type() == TOK_SEMI) {
+                                _lex.skip(TOK_SEMI);
+                                _lex.skip(TOK_WORD);
+                                _lex.skip(TOK_EQ);
+                                number(_lex, parse_qvalue, &m.q);
+                        }
+                        if (_lex.type() == TOK_COMMA)
+                                _lex.skip(TOK_COMMA);
+                        _req.accept.push_back(std::move(m));
+                }
+        } else if (type == TOK_ACCEPT_CHARSET) {
+                while (_lex.type() != TOK_EOL) {
+                        charset set {_req.str(), 1000};
+                        assign(set.type, _lex.lex());
+                        _lex.skip(TOK_WORD);
+                        if (_lex.type() == TOK_SEMI) {
+                                _lex.skip(TOK_SEMI);
+                                _lex.skip(TOK_WORD);
+                                _lex.skip(TOK_EQ);
+                                number(_lex, parse_qvalue, &set.q);
+                        }
+                        if (_lex.type() == TOK_COMMA)
+                                _lex.skip(TOK_COMMA);
+                        _req.charsets.push_back(std::move(set));
+                }
+        } else if (type == TOK_ACCEPT_ENCODING) {
+                while (_lex.type() != TOK_EOL) {
+                        encoding e {_req.str(), 1000};
+                        assign(e.type, _lex.lex());
+                        _lex.skip(TOK_WORD);
+                        if (_lex.type() == TOK_SEMI) {
+                                _lex.skip(TOK_SEMI);
+                                _lex.skip(TOK_WORD);
+                                _lex.skip(TOK_EQ);
+                                number(_lex, parse_qvalue, &e.q);
+                        }
+                        if (_lex.type() == TOK_COMMA)
+                                _lex.skip(TOK_COMMA);
+                        _req.encodings.push_back(std::move(e));
+                }
+        } else if (type == TOK_ACCEPT_LANGUAGE) {
+                while (_lex.type() != TOK_EOL) {
+                        language l {_req.str(), 1000};
+                        assign(l.type, _lex.lex());
+                        _lex.skip(TOK_WORD);
+                        if (_lex.type() == TOK_SEMI) {
+                                _lex.skip(TOK_SEMI);
+                                _lex.skip(TOK_WORD);
+                                _lex.skip(TOK_EQ);
+                                number(_lex, parse_qvalue, &l.q);
+                        }
+                        if (_lex.type() == TOK_COMMA)
+                                _lex.skip(TOK_COMMA);
+                        _req.langs.push_back(std::move(l));
+                }
+        } else if (type == TOK_AUTHORIZATION) {
+                assign(_req.auth, _lex.lex());
+                _lex.skip(TOK_WORD);
+        } else if (type == TOK_CACHE_CONTROL) {
+                parse_cache(_lex, _req);
+        } else if (type == TOK_CONNECTION) {
+                assign(_req.connect, _lex.lex());
+                _lex.skip(TOK_WORD);
+        } else if (type == TOK_CONTENT_ENCODING) {
+                assign(_req.ctnt_encoding, _lex.lex());
+                _lex.skip(TOK_WORD);
+        } else if (type == TOK_CONTENT_LANGUAGE) {
+                while (_lex.type() != TOK_EOL) {
+                        language lang {_req.str(), 0};
+                        assign(lang.type, _lex.lex());
+                        _req.ctnt_langs.push_back(std::move(lang));
+                        _lex.skip(TOK_WORD);
+                        if (_lex.type() == TOK_COMMA)
+                                _lex.skip(TOK_COMMA);
+                }
+        } else if (type == TOK_TRANSFER_ENCODING) {
+                while (_lex.type() != TOK_EOL) {
+                        encoding e {_req.str(), 0};
+                        assign(e.type, _lex.lex());
+                        _lex.skip(TOK_WORD);
+                        if (_lex.type() == TOK_COMMA)
+                                _lex.skip(TOK_COMMA);
+                        _req.transfer.push_back(std::move(e));
+                }
+        }
+
+        _lex.skip(TOK_EOL);
+}
+
+void parser::on_body(body_cb cb)
+{
+        _body = cb;
+}
+
+void parser::max_head(size_t n)
+{
+        _max_head = n;
+}
+
+/*
+ * how much of the body the caller may move past the parser: what is
+ * left of the body or the current chunk, provided none of it is
+ * already buffered here.
+ */
+uint64_t parser::body_left(void) const
+{
+        if (_state == PARSE_ERROR || !in_data() || _line != _len)
+                return 0;
+        return _left;
+}
+
+/*
+ * account for n body bytes the caller moved itself; n must not be
+ * more than body_left().
+ */
+int parser::body_skip(uint64_t n)
+{
+        if (n > body_left())
+                return _state;
+
+        _left -= n;
+        _base += n;
+        if (_state != PARSE_DONE)
+                run();
+        keep();
+        return _state;
+}
+
+int parser::state(void) const
+{
+        return _state;
+}
+
+const arena_stats& parser::mem(void) const
+{
+        return _arena.stats();
+}
+
+const parse_error& parser::error(void) const
+{
+        return _err;
+}
+
+const request& parser::req(void) const
+{
+        return _req;
+}
+
+const name_table& parser::names(void) const
+{
+        return _names;
+}
+
+/*
+ * parse a header a lazy first pass skipped. a failure is reported
+ * through error() but leaves the parser's state alone, since the
+ * request itself was read fine.
+ */
+bool parser::load(int hdr)
+{
+        auto bit = uint64_t{1} << hdr;
+        if (!_req.has(hdr) || (_req.parsed & bit))
+                return !(_req.bad & bit);
+
+        auto state = _state;
+        parse_value(hdr, _req.fields[_req.at[hdr]].value);
+        _state = state;
+        return !(_req.bad & bit);
+}
+
+#ifdef PARSE_STATS
+parse_stats& parser::stats(void)
+{
+        return _stats;
+}
+#endif
+
+size_t parser::pending(void) const
+{
+        return _len - _start;
+}
+
+void parser::reset(void)
+{
+        STAT_REQUEST(false);
+        _buf.clear();
+        _data = nullptr;
+        _len = 0;
+        _req.clear();
+        _arena.reset();
+        _names.clear();
+        _err = parse_error{ERR_NONE, 0, TOK_EOF, TOK_EOF};
+        _base = 0;
+        _start = 0;
+        _line = 0;
+        _scan = 0;
+        _hend = 0;
+        _reqoff = 0;
+        _left = 0;
+        _phase = PHASE_HEAD;
+        _state = PARSE_NEED_MORE;
+        _first = true;
+}
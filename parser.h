@@ -0,0 +1,137 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "lexer.h"
+#include "names.h"
+#include "request.h"
+#include "stats.h"
+#include <functional>
+#include <string>
+
+enum {
+        PARSE_NEED_MORE,
+        PARSE_DONE,
+        PARSE_ERROR,
+};
+
+/*
+ * where the parser is within a request. the head is read line by
+ * line; a Content-Length body and chunk data are counted off in
+ * _left instead.
+ */
+enum {
+        PHASE_HEAD,
+        PHASE_BODY,
+        PHASE_CHUNK_SIZE,
+        PHASE_CHUNK_DATA,
+        PHASE_CHUNK_END,
+        PHASE_TRAILER,
+};
+
+typedef std::function<void(const request&)> request_cb;
+typedef std::function<void(const request&, const char*, size_t)> body_cb;
+
+/*
+ * push parser: feed() takes input in whatever chunks it arrives in
+ * and parses each line as soon as its CRLF shows up. bytes of an
+ * incomplete line are kept and only the new ones are searched on
+ * the next call, so no byte is scanned twice. input is parsed in
+ * the caller's buffer when possible; only a request split across
+ * calls is copied.
+ *
+ * one parser serves a whole connection. with a callback, every
+ * request is handed to it as it completes and parsing carries on
+ * with the pipelined bytes behind it. without one, feed() stops at
+ * PARSE_DONE until next() is called.
+ *
+ * on PARSE_ERROR, error() says what went wrong and where; the parser
+ * stays there until reset() readies it for another connection.
+ *
+ * a request head, or a chunk size or trailer line, longer than
+ * max_head() bytes (64 KiB unless set) fails with ERR_TOO_LONG as
+ * soon as that many bytes are in, so a peer that never ends its head
+ * can't make the parser hold more.
+ *
+ * a lazy parser only notes where each header's value is on the
+ * first pass; request::load() parses a value when it is first
+ * asked for.
+ *
+ * a body, framed by Content-Length or chunked Transfer-Encoding, is
+ * handed to the body callback piece by piece as it arrives, straight
+ * from the buffer it came in; a null pointer ends it. the request
+ * callback has already seen the head by then. body bytes are never
+ * held, so a large upload costs no more memory than its head. a
+ * caller that would rather move the body itself, say with splice(),
+ * asks body_left() how much is still due and reports what it moved
+ * with body_skip().
+ *
+ * a request's storage lives in the parser's arena and is recycled
+ * when the parser moves on to the next request, so a request must
+ * not be kept past that point.
+ *
+ * built with PARSE_STATS, stats() tells where the parse time went;
+ * see stats.h. the figures outlive reset() and add up over every
+ * connection the parser serves.
+ */
+class parser {
+private:
+        std::string _buf {};
+        const char *_data {nullptr};
+        size_t _len {0};
+        arena _arena {};
+        request _req {&_arena, this};
+        name_table _names {};
+        request_cb _cb {};
+        body_cb _body {};
+        parse_error _err {ERR_NONE, 0, TOK_EOF, TOK_EOF};
+        size_t _base {0};
+        size_t _start {0};
+        size_t _line {0};
+        size_t _scan {0};
+        size_t _hend {0};
+        size_t _reqoff {0};
+        uint64_t _left {0};
+        size_t _max_head {size_t{64} << 10};
+        int _phase {PHASE_HEAD};
+        int _state {PARSE_NEED_MORE};
+        bool _first {true};
+        bool _lazy {false};
+        lexer _lex {nullptr, 0};
+#ifdef PARSE_STATS
+        parse_stats _stats {};
+#endif
+        int run(void);
+        void start_next(void);
+        void keep(void);
+        void head_done(void);
+        void body_done(void);
+        void fail(int code, size_t off);
+        bool in_data(void) const;
+        void parse_chunk(size_t len);
+        void parse_line(size_t len);
+        void parse_reqline(void);
+        void parse_header(size_t len);
+        void parse_value(int type, const rawhdr& h);
+        void parse_fields(int type);
+public:
+        parser(request_cb cb = nullptr, bool lazy = false);
+        int feed(const char *buf, size_t len);
+        int next(void);
+        void on_body(body_cb cb);
+        void max_head(size_t n);
+        uint64_t body_left(void) const;
+        int body_skip(uint64_t n);
+        int state(void) const;
+        size_t pending(void) const;
+        const arena_stats& mem(void) const;
+        const parse_error& error(void) const;
+        const request& req(void) const;
+        const name_table& names(void) const;
+        bool load(int hdr);
+        void reset(void);
+#ifdef PARSE_STATS
+        parse_stats& stats(void);
+#endif
+};
+
+#endif
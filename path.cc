@@ -0,0 +1,121 @@
+#include "path.h"
+#include <cstring>
+
+static int hexval(char c)
+{
+        if (c >= '0' && c <= '9')
+                return c - '0';
+        c |= 0x20;
+        if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+        return -1;
+}
+
+/*
+ * the segment written since seg is complete. "." goes away and ".."
+ * takes the segment before it along; an empty one, from a doubled
+ * slash, goes away too. at a slash, what is kept gets one after it.
+ */
+static void end_segment(astring& out, size_t seg, bool slash)
+{
+        auto n = out.size() - seg;
+        auto p = out.data() + seg;
+        if (n == 1 && p[0] == '.') {
+                out.resize(seg);
+        } else if (n == 2 && p[0] == '.' && p[1] == '.') {
+                out.resize(seg);
+                if (seg > 1)
+                        out.resize(out.rfind('/', seg - 2) + 1);
+        } else if (n != 0 && slash) {
+                out += '/';
+        }
+}
+
+bool normalize_path(span target, astring& out, size_t *query)
+{
+        auto p = target.data();
+        auto n = target.size();
+        auto q = static_cast<const char *>(memchr(p, '?', n));
+        *query = q == nullptr ? n : q - p + 1;
+        auto end = q == nullptr ? n : q - p;
+
+        out.clear();
+        if (n == 1 && p[0] == '*') {
+                out += '*';
+                return true;
+        }
+
+        size_t i = 0;
+        if (end != 0 && p[0] != '/') {
+                /* absolute-form: skip the scheme and the authority */
+                auto s = static_cast<const char *>(memchr(p, ':', end));
+                if (s == nullptr || end - (s - p) < 3 || s[1] != '/' ||
+                    s[2] != '/')
+                        return false;
+                i = s - p + 3;
+                while (i < end && p[i] != '/')
+                        i++;
+        } else if (end == 0) {
+                return false;
+        }
+
+        out.reserve(end - i + 1);
+        out += '/';
+        size_t seg = 1;
+        for (i = i < end ? i + 1 : i; i < end; i++) {
+                auto c = p[i];
+                if (c == '/') {
+                        end_segment(out, seg, true);
+                        seg = out.size();
+                        continue;
+                }
+                if (c == '%') {
+                        if (end - i < 3)
+                                return false;
+                        auto hi = hexval(p[i + 1]);
+                        auto lo = hexval(p[i + 2]);
+                        if (hi < 0 || lo < 0 || (hi | lo) == 0)
+                                return false;
+                        c = static_cast<char>(hi << 4 | lo);
+                        i += 2;
+                        if (c == '/') {
+                                out += "%2F";
+                                continue;
+                        }
+                }
+                out += c;
+        }
+        end_segment(out, seg, false);
+        return true;
+}
+
+bool authority_form(span target)
+{
+        auto p = target.data();
+        auto n = target.size();
+        auto colon = n;
+        while (colon > 0 && p[colon - 1] != ':')
+                colon--;
+        if (colon < 2 || colon == n || n - colon > 5)
+                return false;
+
+        uint32_t port = 0;
+        for (auto i = colon; i < n; i++) {
+                if (p[i] < '0' || p[i] > '9')
+                        return false;
+                port = port * 10 + (p[i] - '0');
+        }
+        if (port > 65535)
+                return false;
+
+        size_t host = colon - 1;
+        if (p[0] == '[')
+                return host > 2 && p[host - 1] == ']';
+        for (size_t i = 0; i < host; i++) {
+                auto c = p[i];
+                if (c == '/' || c == '?' || c == '#' || c == '@' ||
+                    c == ':' || c == '[' || c == ']')
+                        return false;
+        }
+        return true;
+}
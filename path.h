@@ -0,0 +1,31 @@
+#ifndef PATH_H
+#define PATH_H
+
+#include "request.h"
+#include "span.h"
+#include <cstddef>
+
+/*
+ * the path of a request-target, made canonical in one pass: percent
+ * escapes decoded, runs of slashes collapsed and "." and ".." segments
+ * resolved, without ever climbing above the root. an escaped slash
+ * stays escaped, as %2F, so it can't split a segment. the query is
+ * whatever follows the first '?', left as it is.
+ *
+ * origin-form targets ("/a/b?q") are the usual; an absolute-form one
+ * ("http://host/a") gives the path after its authority, and "*"
+ * stays "*". the path goes into out, which is allocated once; *query
+ * is set to the offset of the query within the target, or to its
+ * length if there is none. false for a target that isn't one of
+ * those forms, has a malformed escape or decodes to a NUL.
+ */
+bool normalize_path(span target, astring& out, size_t *query);
+
+/*
+ * is target in authority-form, "host:port", the form CONNECT takes
+ * and only CONNECT? the host is a name, an IPv4 address or an IPv6
+ * one in brackets; the port is required.
+ */
+bool authority_form(span target);
+
+#endif
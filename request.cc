@@ -0,0 +1,130 @@
+#include "request.h"
+#include "header.h"
+#include "names.h"
+#include "parser.h"
+#include <cstring>
+#include <new>
+#include <strings.h>
+
+request::request(arena *a, parser *p)
+        : mem {a},
+        src {p},
+        raw {nullptr},
+        head {0},
+        seen {0},
+        parsed {0},
+        bad {0},
+        repeated {0},
+        fields(a),
+        method(a),
+        verb {METHOD_OTHER},
+        target {0, 0},
+        query {0, 0},
+        path(a),
+        major {0},
+        minor {0},
+        len {0},
+        accept(a),
+        charsets(a),
+        encodings(a),
+        langs(a),
+        auth(a),
+        connect(a),
+        ctnt_encoding(a),
+        cache {0, 0, 0, 0, 0, {0, 0}, {0, 0}},
+        ctnt_langs(a),
+        md5(a),
+        transfer(a)
+{
+}
+
+/*
+ * an empty string that allocates from the same place as the request
+ */
+astring request::str(void) const
+{
+        return astring(mem);
+}
+
+/*
+ * empty the request for the next one on the connection. nothing is
+ * freed one by one: the owner resets the arena afterwards, so every
+ * container is rebuilt rather than cleared or assigned to, either
+ * of which can leave a string holding on to recycled memory.
+ */
+void request::clear(void)
+{
+        auto a = mem;
+        auto p = src;
+        this->~request();
+        new (this) request{a, p};
+}
+
+bool request::has(int hdr) const
+{
+        return seen & uint64_t{1} << hdr;
+}
+
+/*
+ * the unparsed value of a header, empty if it wasn't sent
+ */
+span request::value(int hdr) const
+{
+        if (!has(hdr))
+                return span{};
+        return text(fields[at[hdr]].value);
+}
+
+/*
+ * the unparsed value of a header by name, known or not; the first
+ * one if it was sent more than once
+ */
+span request::value(const char *name) const
+{
+        auto hdr = header_lookup(name, strlen(name));
+        if (hdr >= 0)
+                return value(hdr);
+
+        auto i = find(name);
+        if (i == fields.size())
+                return span{};
+        return text(fields[i].value);
+}
+
+/*
+ * index in fields of the first line at or after from with the given
+ * name, known or not; fields.size() if there is none
+ */
+size_t request::find(const char *name, size_t from) const
+{
+        auto n = strlen(name);
+        int id = header_lookup(name, n);
+        if (id < 0 && src != nullptr)
+                id = src->names().find(name, n);
+
+        for (auto i = from; i < fields.size(); i++) {
+                const auto& f = fields[i];
+                if (id >= 0 ? f.id == static_cast<uint32_t>(id) :
+                    f.id >= FIELD_OTHER && f.name.len == n &&
+                    strncasecmp(raw + f.name.off, name, n) == 0)
+                        return i;
+        }
+        return fields.size();
+}
+
+span request::text(const rawhdr& h) const
+{
+        return span{raw + h.off, h.len};
+}
+
+/*
+ * make sure the structured fields for a header are filled in.
+ * false if its value doesn't parse; the parser's error() says why.
+ */
+bool request::load(int hdr) const
+{
+        auto bit = uint64_t{1} << hdr;
+        if (!has(hdr) || (parsed & bit) || src == nullptr)
+                return !(bad & bit);
+        return src->load(hdr);
+}
@@ -0,0 +1,189 @@
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#include "arena.h"
+#include "span.h"
+#include "token.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+typedef std::basic_string<char, std::char_traits<char>, arena_alloc<char>>
+        astring;
+
+template <typename T>
+using avector = std::vector<T, arena_alloc<T>>;
+
+/*
+ * q in the Accept-* elements is the q-value in thousandths, 1000 if
+ * none was sent
+ */
+struct media {
+        astring type;
+        astring subtype;
+        uint16_t q;
+};
+
+struct charset {
+        astring type;
+        uint16_t q;
+};
+
+struct encoding {
+        astring type;
+        uint16_t q;
+};
+
+struct language {
+        astring type;
+        uint16_t q;
+};
+
+static_assert(TOK_COUNT <= 64, "header bitmasks hold 64 tokens");
+
+/*
+ * where a header's name or value sits, counted from the start of the
+ * request; a value is without the CRLF that ends it.
+ */
+struct rawhdr {
+        uint32_t off;
+        uint32_t len;
+};
+
+/* request methods; header.cc has their names */
+enum {
+        METHOD_OTHER,   /* an extension method: request::method has it */
+        METHOD_GET,
+        METHOD_HEAD,
+        METHOD_POST,
+        METHOD_PUT,
+        METHOD_DELETE,
+        METHOD_CONNECT,
+        METHOD_OPTIONS,
+        METHOD_TRACE,
+        METHOD_PATCH,
+        METHOD_COUNT,
+};
+
+/* Cache-Control directives; header.cc has their names */
+enum {
+        CC_NO_CACHE,
+        CC_NO_STORE,
+        CC_MAX_AGE,
+        CC_MAX_STALE,
+        CC_MIN_FRESH,
+        CC_S_MAXAGE,
+        CC_NO_TRANSFORM,
+        CC_ONLY_IF_CACHED,
+        CC_PUBLIC,
+        CC_PRIVATE,
+        CC_MUST_REVALIDATE,
+        CC_PROXY_REVALIDATE,
+        CC_MUST_UNDERSTAND,
+        CC_IMMUTABLE,
+        CC_STALE_WHILE_REVALIDATE,
+        CC_STALE_IF_ERROR,
+        CC_EXTENSION,   /* any directive not listed above */
+        CC_COUNT,
+};
+
+/*
+ * Cache-Control, every directive of it: bit CC_* of dirs is set for
+ * each one present. the delta-seconds arguments are kept, max-stale
+ * without one as UINT32_MAX, since then any staleness will do. the
+ * field names no-cache and private can carry are left where they
+ * are in the request.
+ */
+struct cache_ctl {
+        uint32_t dirs;
+        uint32_t max_age;
+        uint32_t max_stale;
+        uint32_t min_fresh;
+        uint32_t s_maxage;
+        rawhdr nocache_fields;
+        rawhdr private_fields;
+
+        bool has(int dir) const
+        {
+                return dirs & uint32_t{1} << dir;
+        }
+};
+
+static_assert(CC_COUNT <= 32, "cache_ctl::dirs holds 32 directives");
+
+/*
+ * one header line. id is the name's TOK_* value for a known header,
+ * or its id in the parser's name_table (names.h) otherwise.
+ */
+struct field {
+        uint32_t id;
+        rawhdr name;
+        rawhdr value;
+};
+
+class parser;
+
+/*
+ * every string and vector in a request draws from the arena given to
+ * the constructor, or from the heap if there is none.
+ *
+ * raw is where the request starts in the input and head the length
+ * of its head there, blank line and all, once that has been read.
+ * method is the method as sent and verb the METHOD_* it is, so code
+ * acting on it can switch instead of comparing strings.
+ * target is the request-target as sent and query the part of it
+ * after the '?'; path is the target's path made canonical (path.h),
+ * or empty for CONNECT, whose target is a host and port.
+ *
+ * fields holds every header line, known or not, in the order they
+ * came. at[] gives the index there of each known header that was
+ * present (bit TOK_* of seen); for one sent more than once (bit
+ * TOK_* of repeated) that is the first line only. the structured
+ * fields below are only filled in for headers whose bit is set in
+ * parsed; load() fills them in on first use when the parser was
+ * told to be lazy. a value that didn't parse also has its bit set
+ * in bad, and load() keeps failing it rather than offer what was
+ * built before the error.
+ */
+struct request {
+        arena *mem;
+        parser *src;
+        const char *raw;
+        uint32_t head;
+        uint64_t seen;
+        uint64_t parsed;
+        uint64_t bad;
+        uint64_t repeated;
+        avector<field> fields;
+        uint32_t at[TOK_COUNT];
+        astring method;
+        uint8_t verb;
+        rawhdr target;
+        rawhdr query;
+        astring path;
+        uint8_t major;
+        uint8_t minor;
+        uint64_t len;
+        avector<media> accept;
+        avector<charset> charsets;
+        avector<encoding> encodings;
+        avector<language> langs;
+        astring auth;
+        astring connect;
+        astring ctnt_encoding;
+        cache_ctl cache;
+        avector<language> ctnt_langs;
+        astring md5;
+        avector<encoding> transfer;
+        request(arena *a = nullptr, parser *p = nullptr);
+        astring str(void) const;
+        bool has(int hdr) const;
+        span value(int hdr) const;
+        span value(const char *name) const;
+        size_t find(const char *name, size_t from = 0) const;
+        span text(const rawhdr& h) const;
+        bool load(int hdr) const;
+        void clear(void);
+};
+
+#endif
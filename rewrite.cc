@@ -0,0 +1,137 @@
+#include "rewrite.h"
+#include "scan.h"
+#include <cctype>
+#include <cstring>
+#include <strings.h>
+
+rewriter::rewriter(const request& req)
+        : _req {req},
+        _edit(req.fields.size(), KEEP)
+{
+}
+
+/* a header name as RFC 7230 has it: one or more tchars */
+static bool token(const char *name)
+{
+        if (*name == '\0')
+                return false;
+        for (auto p = name; *p != '\0'; p++) {
+                auto c = static_cast<unsigned char>(*p);
+                if (!isalnum(c) && strchr("!#$%&'*+-.^_`|~", c) == nullptr)
+                        return false;
+        }
+        return true;
+}
+
+/*
+ * a value holds no control characters but HTAB, the same bytes the
+ * parser lets through (RFC 7230, 3.2.4)
+ */
+static bool clean(const std::string& value)
+{
+        return scan_ctl(value.data(), value.size()) == value.size();
+}
+
+bool rewriter::set(const char *name, const std::string& value)
+{
+        if (!token(name) || !clean(value))
+                return false;
+
+        auto i = _req.find(name);
+        if (i == _req.fields.size()) {
+                for (auto k : _added) {
+                        if (strcasecmp(_lines[k].name.c_str(), name) == 0) {
+                                _lines[k].value = value;
+                                return true;
+                        }
+                }
+                return add(name, value);
+        }
+
+        _edit[i] = static_cast<int>(_lines.size());
+        _lines.push_back(line{name, value});
+        while ((i = _req.find(name, i + 1)) != _req.fields.size())
+                _edit[i] = DROP;
+        return true;
+}
+
+bool rewriter::add(const char *name, const std::string& value)
+{
+        if (!token(name) || !clean(value))
+                return false;
+
+        _added.push_back(_lines.size());
+        _lines.push_back(line{name, value});
+        return true;
+}
+
+void rewriter::drop(const char *name)
+{
+        for (auto i = _req.find(name); i != _req.fields.size();
+                        i = _req.find(name, i + 1))
+                _edit[i] = DROP;
+}
+
+/* append bytes to the list, joining them to the last entry if they follow on */
+void rewriter::push(const char *p, size_t n)
+{
+        if (n == 0)
+                return;
+        if (!_iov.empty()) {
+                auto& last = _iov.back();
+                if (static_cast<char *>(last.iov_base) + last.iov_len == p) {
+                        last.iov_len += n;
+                        return;
+                }
+        }
+        _iov.push_back(iovec{const_cast<char *>(p), n});
+}
+
+/*
+ * the request line and each header line are copied by reference up
+ * to the first edited one, and so on to the blank line; added lines
+ * go just before it. new lines are formatted first, so _out no
+ * longer moves once the list points into it.
+ */
+const std::vector<iovec>& rewriter::iov(void)
+{
+        std::vector<size_t> at;
+        _out.clear();
+        for (const auto& l : _lines) {
+                at.push_back(_out.size());
+                _out += l.name;
+                _out += ": ";
+                _out += l.value;
+                _out += "\r\n";
+        }
+        at.push_back(_out.size());
+
+        auto raw = _req.raw;
+        auto end = _req.head - 2;
+        size_t pos = 0;
+        _iov.clear();
+        for (size_t i = 0; i < _req.fields.size(); i++) {
+                if (_edit[i] == KEEP)
+                        continue;
+                const auto& f = _req.fields[i];
+                push(raw + pos, f.name.off - pos);
+                if (_edit[i] != DROP)
+                        push(_out.data() + at[_edit[i]],
+                                at[_edit[i] + 1] - at[_edit[i]]);
+                pos = f.value.off + f.value.len + 2;
+        }
+        push(raw + pos, end - pos);
+        for (auto k : _added)
+                push(_out.data() + at[k], at[k + 1] - at[k]);
+        push(raw + end, 2);
+        return _iov;
+}
+
+/* bytes the list last built covers */
+size_t rewriter::size(void) const
+{
+        size_t n = 0;
+        for (const auto& v : _iov)
+                n += v.iov_len;
+        return n;
+}
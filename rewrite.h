@@ -0,0 +1,54 @@
+#ifndef REWRITE_H
+#define REWRITE_H
+
+#include "request.h"
+#include <cstddef>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+/*
+ * lays out a request's head again, with some headers changed, as an
+ * iovec list one writev() can send on. runs of lines left alone point
+ * into the request's own bytes; only headers set or added here are
+ * formatted, all into one buffer the rewriter owns.
+ *
+ * set() replaces a header where it stood, dropping any repeats of
+ * it, or adds it if it wasn't sent. add() puts a line after the last
+ * header whether or not the name is there already, and drop()
+ * removes every line of a name. names are matched without regard to
+ * case. a name that isn't a token, or a value holding a control
+ * character other than HTAB, is refused, so a header can't be
+ * smuggled in through either; the parser refuses the same values.
+ *
+ * the list points into the request and the rewriter, and so is good
+ * until either is changed. it covers the head only; the body follows
+ * as it came, through the parser's body callback or body_skip().
+ */
+class rewriter {
+private:
+        enum {
+                KEEP = -1,
+                DROP = -2,
+        };
+        struct line {
+                std::string name;
+                std::string value;
+        };
+        const request& _req;
+        std::vector<int> _edit {};
+        std::vector<line> _lines {};
+        std::vector<size_t> _added {};
+        std::string _out {};
+        std::vector<iovec> _iov {};
+        void push(const char *p, size_t n);
+public:
+        rewriter(const request& req);
+        bool set(const char *name, const std::string& value);
+        bool add(const char *name, const std::string& value);
+        void drop(const char *name);
+        const std::vector<iovec>& iov(void);
+        size_t size(void) const;
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include "router.h"
+#include <algorithm>
+#include <cstring>
+
+/*
+ * the trie as routes are added to it, before compile() lays it out
+ * flat. a ":name" child's label is empty; the segment it stands for
+ * is whatever is there at match time.
+ */
+struct router::tree {
+        std::string label;
+        std::vector<std::unique_ptr<tree>> kids;
+        std::unique_ptr<tree> param;
+        std::string name;
+        int id {-1};
+        int wild {-1};
+};
+
+router::router(void)
+        : _root {new tree}
+{
+}
+
+router::~router(void) = default;
+
+/*
+ * add static text below t, splitting a child whose label only
+ * partly matches. returns the node the text ends at.
+ */
+router::tree *router::insert(tree *t, const char *s, size_t n)
+{
+        while (n != 0) {
+                auto it = std::find_if(t->kids.begin(), t->kids.end(),
+                        [s](const std::unique_ptr<tree>& k) {
+                                return k->label[0] == s[0];
+                        });
+                if (it == t->kids.end()) {
+                        t->kids.emplace_back(new tree);
+                        t->kids.back()->label.assign(s, n);
+                        return t->kids.back().get();
+                }
+
+                auto& kid = *it;
+                size_t k = 0;
+                while (k < n && k < kid->label.size() && kid->label[k] == s[k])
+                        k++;
+                if (k < kid->label.size()) {
+                        std::unique_ptr<tree> mid {new tree};
+                        mid->label = kid->label.substr(0, k);
+                        kid->label.erase(0, k);
+                        mid->kids.push_back(std::move(kid));
+                        kid = std::move(mid);
+                }
+                t = kid.get();
+                s += k;
+                n -= k;
+        }
+        return t;
+}
+
+bool router::add(const char *pattern, int id)
+{
+        auto p = pattern;
+        auto n = strlen(p);
+        if (n == 0 || p[0] != '/' || id < 0)
+                return false;
+
+        auto t = _root.get();
+        size_t params = 0;
+        size_t i = 0;
+        while (i < n) {
+                auto start = i == 0 || p[i - 1] == '/';
+                if (start && (p[i] == ':' || p[i] == '*')) {
+                        auto e = i + 1;
+                        while (e < n && p[e] != '/')
+                                e++;
+                        if (e == i + 1 || ++params > route_match::MAX)
+                                return false;
+                        std::string name {p + i + 1, e - i - 1};
+                        if (p[i] == '*') {
+                                if (e != n || t->wild >= 0)
+                                        return false;
+                                t->wild = id;
+                                return true;
+                        }
+                        if (t->param == nullptr) {
+                                t->param.reset(new tree);
+                                t->param->name = name;
+                        } else if (t->param->name != name) {
+                                return false;
+                        }
+                        t = t->param.get();
+                        i = e;
+                        continue;
+                }
+
+                auto e = i + 1;
+                while (e < n && !(p[e - 1] == '/' &&
+                                (p[e] == ':' || p[e] == '*')))
+                        e++;
+                t = insert(t, p + i, e - i);
+                i = e;
+        }
+
+        if (t->id >= 0)
+                return false;
+        t->id = id;
+        return true;
+}
+
+/*
+ * write t out at index at. its static children go in one run, so a
+ * node finds them by offset and count.
+ */
+void router::flatten(uint32_t at, tree& t)
+{
+        std::sort(t.kids.begin(), t.kids.end(),
+                [](const std::unique_ptr<tree>& a,
+                                const std::unique_ptr<tree>& b) {
+                        return static_cast<uint8_t>(a->label[0]) <
+                                static_cast<uint8_t>(b->label[0]);
+                });
+
+        node n {static_cast<uint32_t>(_labels.size()),
+                static_cast<uint32_t>(t.label.size()),
+                static_cast<uint32_t>(_nodes.size()),
+                static_cast<uint32_t>(t.kids.size()),
+                -1, t.id, t.wild};
+        _labels += t.label;
+        _nodes.resize(_nodes.size() + t.kids.size());
+        _first.resize(_nodes.size());
+        for (size_t i = 0; i < t.kids.size(); i++)
+                flatten(n.kids + i, *t.kids[i]);
+        if (t.param != nullptr) {
+                n.param = _nodes.size();
+                _nodes.emplace_back();
+                _first.emplace_back();
+                flatten(n.param, *t.param);
+        }
+
+        _nodes[at] = n;
+        _first[at] = t.label.empty() ? 0 : t.label[0];
+}
+
+void router::compile(void)
+{
+        _nodes.assign(1, node{});
+        _first.assign(1, 0);
+        _labels.clear();
+        flatten(0, *_root);
+}
+
+/*
+ * match what is left of the path from node n on. the static child
+ * is tried first, then the parameter, then the wildcard.
+ */
+bool router::walk(uint32_t n, const char *p, size_t len,
+                route_match *m) const
+{
+        const auto& nd = _nodes[n];
+        if (len < nd.len || memcmp(p, _labels.data() + nd.label, nd.len) != 0)
+                return false;
+        p += nd.len;
+        len -= nd.len;
+
+        if (len == 0 && nd.id >= 0) {
+                m->id = nd.id;
+                return true;
+        }
+        if (len != 0) {
+                auto first = _first.begin() + nd.kids;
+                auto last = first + nd.nkids;
+                auto k = std::lower_bound(first, last,
+                        static_cast<uint8_t>(p[0]));
+                if (k != last && *k == static_cast<uint8_t>(p[0]) &&
+                    walk(k - _first.begin(), p, len, m))
+                        return true;
+
+                auto slash = static_cast<const char *>(memchr(p, '/', len));
+                auto seg = slash == nullptr ? len : slash - p;
+                if (nd.param >= 0 && seg != 0) {
+                        m->params[m->nparams++] = span{p, seg};
+                        if (walk(nd.param, p + seg, len - seg, m))
+                                return true;
+                        m->nparams--;
+                }
+        }
+        if (nd.wild >= 0) {
+                m->params[m->nparams++] = span{p, len};
+                m->id = nd.wild;
+                return true;
+        }
+        return false;
+}
+
+bool router::match(span path, route_match *m) const
+{
+        m->id = -1;
+        m->nparams = 0;
+        if (_nodes.empty())
+                return false;
+        return walk(0, path.data(), path.size(), m);
+}
@@ -0,0 +1,68 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include "span.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * what a path matched: the route's id and the values of its
+ * parameters in the order the pattern names them. the values point
+ * into the path that was matched.
+ */
+struct route_match {
+        static const size_t MAX {8};
+        int id;
+        size_t nparams;
+        span params[MAX];
+};
+
+/*
+ * maps canonical paths (path.h) to routes. a pattern is static text
+ * with ":name" standing for one whole segment and, at the very end,
+ * "*name" for whatever is left of the path, slashes and all, as in
+ * "/users", "/users/:id/posts" or "/static/" followed by "*file".
+ *
+ * routes are added first and then compiled into a radix trie laid
+ * out in flat arrays, children sorted by their first byte. a match
+ * walks it once along the path, allocating nothing. static text wins
+ * over a parameter and a parameter over a wildcard; only where a
+ * static branch dead-ends does the walk back up to try the others.
+ *
+ * add() fails for a malformed pattern, one with more than MAX
+ * parameters, or one that gives a parameter a name another pattern
+ * calls differently at the same place. match() is safe to call from
+ * many threads once compile() has been.
+ */
+class router {
+private:
+        struct tree;
+        struct node {
+                uint32_t label;         /* offset in _labels */
+                uint32_t len;
+                uint32_t kids;          /* first static child in _nodes */
+                uint32_t nkids;
+                int32_t param;          /* the ":name" child, or -1 */
+                int32_t id;             /* route ending here, or -1 */
+                int32_t wild;           /* route for "*name" here, or -1 */
+        };
+        std::unique_ptr<tree> _root;
+        std::vector<node> _nodes {};
+        std::vector<uint8_t> _first {};
+        std::string _labels {};
+        static tree *insert(tree *t, const char *s, size_t n);
+        void flatten(uint32_t at, tree& t);
+        bool walk(uint32_t n, const char *p, size_t len,
+                route_match *m) const;
+public:
+        router(void);
+        ~router(void);
+        bool add(const char *pattern, int id);
+        void compile(void);
+        bool match(span path, route_match *m) const;
+};
+
+#endif
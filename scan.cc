@@ -0,0 +1,262 @@
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+typedef size_t (*byte_fn)(const char *, size_t, char);
+typedef size_t (*word_fn)(const char *, size_t, char, char);
+typedef size_t (*ctl_fn)(const char *, size_t);
+
+static bool isword(unsigned char c, char e1, char e2)
+{
+        auto l = c | 0x20;
+        return (l >= 'a' && l <= 'z') || (c >= '0' && c <= '9') ||
+                c == static_cast<unsigned char>(e1) ||
+                c == static_cast<unsigned char>(e2);
+}
+
+static size_t byte_scalar(const char *p, size_t n, char c)
+{
+        size_t i = 0;
+        while (i < n && p[i] != c)
+                i++;
+        return i;
+}
+
+/* first byte that is not a letter, a digit, e1 or e2 */
+static size_t word_scalar(const char *p, size_t n, char e1, char e2)
+{
+        size_t i = 0;
+        while (i < n && isword(p[i], e1, e2))
+                i++;
+        return i;
+}
+
+static bool isctl(unsigned char c)
+{
+        return (c < 0x20 && c != '\t') || c == 0x7f;
+}
+
+static size_t ctl_scalar(const char *p, size_t n)
+{
+        size_t i = 0;
+        while (i < n && !isctl(p[i]))
+                i++;
+        return i;
+}
+
+#ifdef SCAN_X86
+/*
+ * the avx2 scanners finish short tails with the sse2 ones, after
+ * clearing the upper halves of the ymm registers so the legacy sse
+ * code doesn't pay for a state transition.
+ */
+static size_t byte_sse2(const char *p, size_t n, char c)
+{
+        auto needle = _mm_set1_epi8(c);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+                auto v = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i *>(p + i));
+                unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+                if (m != 0)
+                        return i + __builtin_ctz(m);
+        }
+        return i + byte_scalar(p + i, n - i, c);
+}
+
+/*
+ * bytes >= 0x80 are negative as signed chars, so the signed range
+ * compares below reject them without extra work.
+ */
+static size_t word_sse2(const char *p, size_t n, char e1, char e2)
+{
+        auto lo_a = _mm_set1_epi8('a' - 1);
+        auto hi_z = _mm_set1_epi8('z' + 1);
+        auto lo_0 = _mm_set1_epi8('0' - 1);
+        auto hi_9 = _mm_set1_epi8('9' + 1);
+        auto fold = _mm_set1_epi8(0x20);
+        auto x1 = _mm_set1_epi8(e1);
+        auto x2 = _mm_set1_epi8(e2);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+                auto v = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i *>(p + i));
+                auto l = _mm_or_si128(v, fold);
+                auto alpha = _mm_and_si128(_mm_cmpgt_epi8(l, lo_a),
+                        _mm_cmpgt_epi8(hi_z, l));
+                auto digit = _mm_and_si128(_mm_cmpgt_epi8(v, lo_0),
+                        _mm_cmpgt_epi8(hi_9, v));
+                auto ok = _mm_or_si128(_mm_or_si128(alpha, digit),
+                        _mm_or_si128(_mm_cmpeq_epi8(v, x1),
+                                _mm_cmpeq_epi8(v, x2)));
+                unsigned m = ~_mm_movemask_epi8(ok) & 0xffff;
+                if (m != 0)
+                        return i + __builtin_ctz(m);
+        }
+        return i + word_scalar(p + i, n - i, e1, e2);
+}
+
+/* 0x00 to 0x1f as signed bytes, which leaves out those >= 0x80 */
+static size_t ctl_sse2(const char *p, size_t n)
+{
+        auto neg = _mm_set1_epi8(-1);
+        auto sp = _mm_set1_epi8(' ');
+        auto tab = _mm_set1_epi8('\t');
+        auto del = _mm_set1_epi8(0x7f);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+                auto v = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i *>(p + i));
+                auto low = _mm_and_si128(_mm_cmpgt_epi8(v, neg),
+                        _mm_cmpgt_epi8(sp, v));
+                auto ctl = _mm_or_si128(_mm_andnot_si128(
+                        _mm_cmpeq_epi8(v, tab), low),
+                        _mm_cmpeq_epi8(v, del));
+                unsigned m = _mm_movemask_epi8(ctl);
+                if (m != 0)
+                        return i + __builtin_ctz(m);
+        }
+        return i + ctl_scalar(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t byte_avx2(const char *p, size_t n, char c)
+{
+        auto needle = _mm256_set1_epi8(c);
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+                auto v = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i *>(p + i));
+                unsigned m = _mm256_movemask_epi8(
+                        _mm256_cmpeq_epi8(v, needle));
+                if (m != 0)
+                        return i + __builtin_ctz(m);
+        }
+        _mm256_zeroupper();
+        return i + byte_sse2(p + i, n - i, c);
+}
+
+__attribute__((target("avx2")))
+static size_t word_avx2(const char *p, size_t n, char e1, char e2)
+{
+        auto lo_a = _mm256_set1_epi8('a' - 1);
+        auto hi_z = _mm256_set1_epi8('z' + 1);
+        auto lo_0 = _mm256_set1_epi8('0' - 1);
+        auto hi_9 = _mm256_set1_epi8('9' + 1);
+        auto fold = _mm256_set1_epi8(0x20);
+        auto x1 = _mm256_set1_epi8(e1);
+        auto x2 = _mm256_set1_epi8(e2);
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+                auto v = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i *>(p + i));
+                auto l = _mm256_or_si256(v, fold);
+                auto alpha = _mm256_and_si256(_mm256_cmpgt_epi8(l, lo_a),
+                        _mm256_cmpgt_epi8(hi_z, l));
+                auto digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, lo_0),
+                        _mm256_cmpgt_epi8(hi_9, v));
+                auto ok = _mm256_or_si256(_mm256_or_si256(alpha, digit),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(v, x1),
+                                _mm256_cmpeq_epi8(v, x2)));
+                unsigned m = ~static_cast<unsigned>(
+                        _mm256_movemask_epi8(ok));
+                if (m != 0)
+                        return i + __builtin_ctz(m);
+        }
+        _mm256_zeroupper();
+        return i + word_sse2(p + i, n - i, e1, e2);
+}
+
+__attribute__((target("avx2")))
+static size_t ctl_avx2(const char *p, size_t n)
+{
+        auto neg = _mm256_set1_epi8(-1);
+        auto sp = _mm256_set1_epi8(' ');
+        auto tab = _mm256_set1_epi8('\t');
+        auto del = _mm256_set1_epi8(0x7f);
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+                auto v = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i *>(p + i));
+                auto low = _mm256_and_si256(_mm256_cmpgt_epi8(v, neg),
+                        _mm256_cmpgt_epi8(sp, v));
+                auto ctl = _mm256_or_si256(_mm256_andnot_si256(
+                        _mm256_cmpeq_epi8(v, tab), low),
+                        _mm256_cmpeq_epi8(v, del));
+                unsigned m = _mm256_movemask_epi8(ctl);
+                if (m != 0)
+                        return i + __builtin_ctz(m);
+        }
+        _mm256_zeroupper();
+        return i + ctl_sse2(p + i, n - i);
+}
+#endif
+
+static int best_isa(void)
+{
+#ifdef SCAN_X86
+        if (__builtin_cpu_supports("avx2"))
+                return SCAN_AVX2;
+        return SCAN_SSE2;
+#else
+        return SCAN_SCALAR;
+#endif
+}
+
+static int isa {SCAN_SCALAR};
+static byte_fn byte_impl {byte_scalar};
+static word_fn word_impl {word_scalar};
+static ctl_fn ctl_impl {ctl_scalar};
+static int init {scan_select(best_isa())};
+
+size_t scan_byte(const char *p, size_t n, char c)
+{
+        return byte_impl(p, n, c);
+}
+
+size_t scan_word(const char *p, size_t n, char e1, char e2)
+{
+        return word_impl(p, n, e1, e2);
+}
+
+size_t scan_ctl(const char *p, size_t n)
+{
+        return ctl_impl(p, n);
+}
+
+/*
+ * use at most the given instruction set. returns the one actually
+ * selected, which is lower when the cpu can't do what was asked.
+ */
+int scan_select(int want)
+{
+        if (want > best_isa())
+                want = best_isa();
+
+        isa = SCAN_SCALAR;
+        byte_impl = byte_scalar;
+        word_impl = word_scalar;
+        ctl_impl = ctl_scalar;
+#ifdef SCAN_X86
+        if (want == SCAN_SSE2) {
+                isa = SCAN_SSE2;
+                byte_impl = byte_sse2;
+                word_impl = word_sse2;
+                ctl_impl = ctl_sse2;
+        } else if (want == SCAN_AVX2) {
+                isa = SCAN_AVX2;
+                byte_impl = byte_avx2;
+                word_impl = word_avx2;
+                ctl_impl = ctl_avx2;
+        }
+#endif
+        return isa;
+}
+
+int scan_isa(void)
+{
+        return isa;
+}
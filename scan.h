@@ -0,0 +1,31 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+
+enum {
+        SCAN_SCALAR,
+        SCAN_SSE2,
+        SCAN_AVX2,
+};
+
+/*
+ * scanners for the lexer's hot loops. each returns the index of the
+ * first byte that stops the scan, or n if none does: c for
+ * scan_byte(), anything but a letter, a digit, e1 or e2 for
+ * scan_word(), and a control character other than HTAB, CR included,
+ * for scan_ctl(). the widest implementation the cpu supports is
+ * picked at startup; all of them return the same answers.
+ *
+ * the lexer calls them once per token, and header tokens are short:
+ * a scanned run averages about five bytes and few reach sixteen, so
+ * most calls end in the first vector or in the scalar tail. the wide
+ * forms pay on long values and paths, not on token-dense heads.
+ */
+size_t scan_byte(const char *p, size_t n, char c);
+size_t scan_word(const char *p, size_t n, char e1, char e2);
+size_t scan_ctl(const char *p, size_t n);
+int scan_select(int isa);
+int scan_isa(void);
+
+#endif
@@ -0,0 +1,292 @@
+#include "body.h"
+#include "decode.h"
+#include "parser.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const char OK[] {"HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n"};
+static const char BAD[] {
+        "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n"
+        "Connection: close\r\n\r\n"};
+
+/* where request bodies go with -o; without it they are dropped */
+static int sink {-1};
+
+/* -d: undo Content-Encoding and check Content-MD5 on the way there */
+static bool decode {false};
+
+/*
+ * one accepted socket. the parser lives as long as the connection,
+ * so its buffer and arena are set up once however many requests
+ * come down it.
+ */
+struct conn {
+        int fd;
+        bool closing;
+        std::string out;
+        parser p;
+        std::unique_ptr<body_decoder> dec;
+
+        conn(int s)
+                : fd {s},
+                closing {false},
+                out {},
+                p {[this](const request& req) { head(req); }},
+                dec {}
+        {
+                auto cb = [this](const request& req, const char *b,
+                        size_t n) { body(req, b, n); };
+                if (!decode) {
+                        p.on_body(cb);
+                        return;
+                }
+                dec.reset(new body_decoder{cb});
+                p.on_body([this](const request& req, const char *b,
+                        size_t n) { dec->feed(req, b, n); });
+        }
+
+        /* a request with a body is answered once the body is in */
+        void head(const request& req)
+        {
+                if (req.len == 0 && req.transfer.empty())
+                        respond(req);
+        }
+
+        /* body bytes that came in with a read go out with write */
+        void body(const request& req, const char *b, size_t n)
+        {
+                if (b == nullptr && dec && dec->error() != ERR_NONE) {
+                        if (!closing)
+                                out.append(BAD, sizeof(BAD) - 1);
+                        closing = true;
+                        return;
+                }
+                if (b == nullptr) {
+                        respond(req);
+                        return;
+                }
+                while (sink >= 0 && n > 0) {
+                        auto m = write(sink, b, n);
+                        if (m < 0 && errno == EINTR)
+                                continue;
+                        if (m < 0)
+                                err(EX_IOERR, "write");
+                        b += m;
+                        n -= m;
+                }
+        }
+
+        void respond(const request& req)
+        {
+                if (closing)
+                        return;
+                out.append(OK, sizeof(OK) - 1);
+                /* connection options are case-insensitive (RFC 7230, 6.1) */
+                if (strcasecmp(req.connect.c_str(), "close") == 0)
+                        closing = true;
+        }
+};
+
+static int listen_on(int port)
+{
+        auto fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd < 0)
+                err(EX_OSERR, "socket");
+
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)
+                err(EX_OSERR, "SO_REUSEPORT");
+
+        sockaddr_in sa {};
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(port);
+        sa.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(fd, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) < 0)
+                err(EX_OSERR, "bind");
+        if (listen(fd, SOMAXCONN) < 0)
+                err(EX_OSERR, "listen");
+        return fd;
+}
+
+static void drop(int ep, conn *c)
+{
+        epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, nullptr);
+        close(c->fd);
+        delete c;
+}
+
+/*
+ * write what is queued. false once the connection should go away,
+ * either because the peer is gone or because the last response
+ * asked for it to be closed.
+ */
+static bool flush(conn *c)
+{
+        size_t done = 0;
+        while (done < c->out.size()) {
+                auto n = write(c->fd, c->out.data() + done,
+                        c->out.size() - done);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n < 0 && errno == EAGAIN)
+                        break;
+                if (n <= 0)
+                        return false;
+                done += n;
+        }
+        c->out.erase(0, done);
+        return !(c->closing && c->out.empty());
+}
+
+/*
+ * edge-triggered, so read until the socket is drained. every read
+ * goes straight into the parser, which answers through the
+ * connection's callback. body bytes the parser has not seen yet are
+ * spliced from the socket to the sink without being read at all,
+ * unless they have to be decoded first.
+ */
+static bool readable(conn *c)
+{
+        char buf[16384];
+        for (;;) {
+                auto left = c->p.body_left();
+                if (sink >= 0 && left > 0 && !decode) {
+                        auto n = forward(c->fd, sink, left);
+                        if (n < 0 && errno == EINTR)
+                                continue;
+                        if (n < 0 && errno == EAGAIN)
+                                return true;
+                        if (n <= 0)
+                                return false;
+                        c->p.body_skip(n);
+                        continue;
+                }
+
+                auto n = read(c->fd, buf, sizeof(buf));
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n < 0 && errno == EAGAIN)
+                        return true;
+                if (n <= 0)
+                        return false;
+                if (c->p.feed(buf, n) == PARSE_ERROR) {
+                        c->out.append(BAD, sizeof(BAD) - 1);
+                        c->closing = true;
+                        return true;
+                }
+        }
+}
+
+static void accept_all(int ep, int lfd)
+{
+        for (;;) {
+                auto fd = accept4(lfd, nullptr, nullptr, SOCK_NONBLOCK);
+                if (fd < 0)
+                        return;
+
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                auto c = new conn {fd};
+                epoll_event ev {};
+                ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                ev.data.ptr = c;
+                if (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                        close(fd);
+                        delete c;
+                }
+        }
+}
+
+/*
+ * one of these per core, each with its own listening socket on the
+ * same port. the kernel spreads new connections across them.
+ */
+static void loop(int port)
+{
+        auto lfd = listen_on(port);
+        auto ep = epoll_create1(0);
+        if (ep < 0)
+                err(EX_OSERR, "epoll_create1");
+
+        epoll_event ev {};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = nullptr;
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, lfd, &ev) < 0)
+                err(EX_OSERR, "epoll_ctl");
+
+        epoll_event evs[256];
+        for (;;) {
+                auto n = epoll_wait(ep, evs, 256, -1);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n < 0)
+                        err(EX_OSERR, "epoll_wait");
+
+                for (int i = 0; i < n; i++) {
+                        auto c = static_cast<conn *>(evs[i].data.ptr);
+                        if (c == nullptr) {
+                                accept_all(ep, lfd);
+                                continue;
+                        }
+
+                        auto alive = true;
+                        if (evs[i].events & (EPOLLIN | EPOLLRDHUP))
+                                alive = readable(c);
+                        alive = flush(c) && alive;
+                        if (!alive || (evs[i].events & (EPOLLERR | EPOLLHUP)))
+                                drop(ep, c);
+                }
+        }
+}
+
+int main(int argc, char **argv)
+{
+        auto port = 8080;
+        auto threads = static_cast<int>(std::thread::hardware_concurrency());
+        int c;
+
+        while ((c = getopt(argc, argv, "do:p:t:")) != -1) {
+                switch (c) {
+                case 'd':
+                        decode = true;
+                        break;
+                case 'o':
+                        sink = open(optarg, O_WRONLY | O_CREAT | O_TRUNC,
+                                0644);
+                        if (sink < 0)
+                                err(EX_NOINPUT, "%s", optarg);
+                        break;
+                case 'p':
+                        port = atoi(optarg);
+                        break;
+                case 't':
+                        threads = atoi(optarg);
+                        break;
+                default:
+                        usage("usage: %s [-d] [-o sink] [-p port] "
+                                "[-t threads]", argv[0]);
+                }
+        }
+        if (threads < 1)
+                threads = 1;
+
+        std::vector<std::thread> loops;
+        for (int t = 1; t < threads; t++)
+                loops.emplace_back(loop, port);
+        loop(port);
+}
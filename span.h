@@ -0,0 +1,55 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/*
+ * non-owning view of bytes in someone else's buffer. kept inline
+ * since it sits between the lexer and every consumer of a lexeme.
+ */
+class span {
+private:
+        const char *_ptr {nullptr};
+        size_t _len {0};
+public:
+        span(const char *ptr = nullptr, size_t len = 0)
+                : _ptr {ptr},
+                _len {len}
+        {
+        }
+
+        const char *data(void) const
+        {
+                return _ptr;
+        }
+
+        size_t size(void) const
+        {
+                return _len;
+        }
+
+        bool empty(void) const
+        {
+                return _len == 0;
+        }
+
+        std::string str(void) const
+        {
+                return std::string(_ptr, _len);
+        }
+
+        bool operator==(const char *s) const
+        {
+                return strlen(s) == _len &&
+                        (_len == 0 || memcmp(_ptr, s, _len) == 0);
+        }
+
+        bool operator!=(const char *s) const
+        {
+                return !(*this == s);
+        }
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include "stats.h"
+
+#ifdef PARSE_STATS
+
+#include <chrono>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define STATS_TSC 1
+#endif
+
+/*
+ * the time stamp counter where there is one; elsewhere nanoseconds,
+ * which serve just as well for comparing phases.
+ */
+uint64_t stat_clock(void)
+{
+#ifdef STATS_TSC
+        return __rdtsc();
+#else
+        auto t = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t)
+                .count();
+#endif
+}
+
+const char *stat_name(int phase)
+{
+        static const char *names[] = {
+                "reqline",
+                "header",
+                "value",
+                "framing",
+                "chunk",
+        };
+        static_assert(sizeof(names) / sizeof(names[0]) == STAT_COUNT,
+                "stat_name() is missing a phase");
+
+        if (phase < 0 || phase >= STAT_COUNT)
+                return "?";
+        return names[phase];
+}
+
+/* bucket b > 0 holds [2^(b-1), 2^b) */
+void stat_hist::add(uint64_t v)
+{
+        n[v == 0 ? 0 : 64 - __builtin_clzll(v)]++;
+}
+
+uint64_t stat_hist::total(void) const
+{
+        uint64_t t = 0;
+        for (auto c : n)
+                t += c;
+        return t;
+}
+
+/*
+ * the upper bound of the bucket the p-th fraction of samples falls
+ * in, or 0 with no samples.
+ */
+uint64_t stat_hist::pct(double p) const
+{
+        auto t = total();
+        if (t == 0)
+                return 0;
+
+        auto want = static_cast<uint64_t>(p * t);
+        if (want >= t)
+                want = t - 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+                seen += n[b];
+                if (seen > want)
+                        return b == 0 ? 0 :
+                                b == 64 ? UINT64_MAX : (uint64_t{1} << b) - 1;
+        }
+        return UINT64_MAX;
+}
+
+void stat_counter::merge(const stat_counter& c)
+{
+        count += c.count;
+        bytes += c.bytes;
+        tokens += c.tokens;
+        allocs += c.allocs;
+        cycles += c.cycles;
+        for (int b = 0; b < stat_hist::BUCKETS; b++)
+                hist.n[b] += c.hist.n[b];
+}
+
+parse_stats::parse_stats(void)
+{
+        clear();
+}
+
+/*
+ * a request is over: count what it took, unless it never finished,
+ * as when the parser is reset midway.
+ */
+void parse_stats::end_request(bool done)
+{
+        if (done) {
+                request.add(cur);
+                requests++;
+        }
+        cur = 0;
+}
+
+void parse_stats::merge(const parse_stats& s)
+{
+        for (int i = 0; i < STAT_COUNT; i++)
+                phase[i].merge(s.phase[i]);
+        for (int i = 0; i < TOK_COUNT; i++)
+                header[i].merge(s.header[i]);
+        for (int b = 0; b < stat_hist::BUCKETS; b++)
+                request.n[b] += s.request.n[b];
+        requests += s.requests;
+}
+
+void parse_stats::clear(void)
+{
+        memset(phase, 0, sizeof(phase));
+        memset(header, 0, sizeof(header));
+        memset(&request, 0, sizeof(request));
+        requests = 0;
+        cur = 0;
+        memset(inner, 0, sizeof(inner));
+}
+
+static void dump_hist(FILE *fp, const stat_hist& h)
+{
+        fprintf(fp, "\"p50\":%llu,\"p99\":%llu,\"p999\":%llu",
+                static_cast<unsigned long long>(h.pct(0.5)),
+                static_cast<unsigned long long>(h.pct(0.99)),
+                static_cast<unsigned long long>(h.pct(0.999)));
+}
+
+static void dump_counter(FILE *fp, const char *name, const stat_counter& c)
+{
+        fprintf(fp, "\"%s\":{\"count\":%llu,\"bytes\":%llu,"
+                "\"tokens\":%llu,\"allocs\":%llu,\"cycles\":%llu,",
+                name,
+                static_cast<unsigned long long>(c.count),
+                static_cast<unsigned long long>(c.bytes),
+                static_cast<unsigned long long>(c.tokens),
+                static_cast<unsigned long long>(c.allocs),
+                static_cast<unsigned long long>(c.cycles));
+        dump_hist(fp, c.hist);
+        fputc('}', fp);
+}
+
+/*
+ * one JSON object: requests and their head latency, then every phase,
+ * then each header type that was seen, keyed by token name.
+ */
+void parse_stats::dump(FILE *fp) const
+{
+        fprintf(fp, "{\"requests\":%llu,\"request\":{",
+                static_cast<unsigned long long>(requests));
+        dump_hist(fp, request);
+        fputs("},\"phases\":{", fp);
+        for (int i = 0; i < STAT_COUNT; i++) {
+                if (i != 0)
+                        fputc(',', fp);
+                dump_counter(fp, stat_name(i), phase[i]);
+        }
+        fputs("},\"headers\":{", fp);
+        auto first = true;
+        for (int i = 0; i < TOK_COUNT; i++) {
+                if (header[i].count == 0)
+                        continue;
+                if (!first)
+                        fputc(',', fp);
+                first = false;
+                dump_counter(fp, token_name(i), header[i]);
+        }
+        fputs("}}\n", fp);
+}
+
+stat_scope::stat_scope(parse_stats& s, const arena& mem,
+                const uint64_t& tokens, int phase, size_t bytes, int type)
+        : _s {s},
+        _mem {mem},
+        _tokens {tokens},
+        _phase {phase},
+        _type {type},
+        _bytes {bytes}
+{
+        memcpy(_outer, _s.inner, sizeof(_outer));
+        memset(_s.inner, 0, sizeof(_s.inner));
+        _start[1] = _tokens;
+        _start[2] = _mem.stats().allocs;
+        _start[0] = stat_clock();
+}
+
+stat_scope::~stat_scope(void)
+{
+        uint64_t all[3] = {
+                stat_clock() - _start[0],
+                _tokens - _start[1],
+                _mem.stats().allocs - _start[2],
+        };
+        uint64_t own[3];
+        for (int i = 0; i < 3; i++) {
+                own[i] = all[i] - _s.inner[i];
+                _s.inner[i] = _outer[i] + all[i];
+        }
+
+        auto add = [&](stat_counter& c) {
+                c.count++;
+                c.bytes += _bytes;
+                c.cycles += own[0];
+                c.tokens += own[1];
+                c.allocs += own[2];
+                c.hist.add(own[0]);
+        };
+        add(_s.phase[_phase]);
+        if (_type >= 0)
+                add(_s.header[_type]);
+        _s.cur += own[0];
+}
+
+#endif
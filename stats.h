@@ -0,0 +1,110 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*
+ * parse-time instrumentation, built only with -DPARSE_STATS (make
+ * STATS=1). without it none of this is compiled into the parser,
+ * which then carries no counters and reads no clocks.
+ *
+ * a parser with stats splits its work into phases and counts, for
+ * each, the bytes it covered, the tokens lexed, arena allocations
+ * and cycles spent. value parsing is also counted per header type.
+ * phases nest, a header line parsing its value for instance, and
+ * each is charged only for its own share. cycle counts also go into
+ * histograms with power-of-two buckets, so tail percentiles come
+ * out within a factor of two.
+ */
+#ifdef PARSE_STATS
+
+#include "arena.h"
+#include "token.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+enum {
+        STAT_REQLINE,   /* the request line */
+        STAT_HEADER,    /* header lines, short of their values */
+        STAT_VALUE,     /* parsing header values into the request */
+        STAT_FRAMING,   /* working out how the body is framed */
+        STAT_CHUNK,     /* chunk size lines */
+        STAT_COUNT,
+};
+
+struct stat_hist {
+        static const int BUCKETS {65};
+        uint64_t n[BUCKETS];
+
+        void add(uint64_t v);
+        uint64_t total(void) const;
+        uint64_t pct(double p) const;
+};
+
+struct stat_counter {
+        uint64_t count;
+        uint64_t bytes;
+        uint64_t tokens;
+        uint64_t allocs;
+        uint64_t cycles;
+        stat_hist hist;
+
+        void merge(const stat_counter& c);
+};
+
+/*
+ * one parser's figures. merge() sums several, one per thread say,
+ * into a snapshot; dump() writes one out as JSON.
+ */
+class parse_stats {
+public:
+        stat_counter phase[STAT_COUNT];
+        stat_counter header[TOK_COUNT];
+        stat_hist request;      /* cycles per request */
+        uint64_t requests;
+        uint64_t cur;           /* the current request's cycles so far */
+        uint64_t inner[3];      /* charged to the innermost open scope */
+
+        parse_stats(void);
+        void end_request(bool done);
+        void merge(const parse_stats& s);
+        void clear(void);
+        void dump(FILE *fp) const;
+};
+
+const char *stat_name(int phase);
+uint64_t stat_clock(void);
+
+/*
+ * counts one phase from construction to destruction. what nested
+ * scopes took is taken off the outer one.
+ */
+class stat_scope {
+private:
+        parse_stats& _s;
+        const arena& _mem;
+        const uint64_t& _tokens;
+        int _phase;
+        int _type;
+        size_t _bytes;
+        uint64_t _start[3];
+        uint64_t _outer[3];
+public:
+        stat_scope(parse_stats& s, const arena& mem, const uint64_t& tokens,
+                int phase, size_t bytes, int type = -1);
+        ~stat_scope(void);
+        stat_scope(const stat_scope&) = delete;
+        stat_scope& operator=(const stat_scope&) = delete;
+};
+
+#define STAT_SCOPE(...) \
+        stat_scope stat_scope_ {_stats, _arena, _lex.lexed(), __VA_ARGS__}
+#define STAT_REQUEST(done) _stats.end_request(done)
+
+#else
+
+#define STAT_SCOPE(...) do { } while (0)
+#define STAT_REQUEST(done) do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+#include "batch.h"
+#include "check.h"
+#include <cstdlib>
+#include <string>
+
+/* what both sides write for each request */
+static bool line(FILE *out, const request& req)
+{
+        fprintf(out, "%s %s %zu %llu\n", req.method.c_str(),
+                req.path.c_str(), req.accept.size(),
+                static_cast<unsigned long long>(req.len));
+        return true;
+}
+
+/* in through one parser, the way batch_parse() has to match */
+static std::string sequential(const std::string& in, parse_error *err)
+{
+        char *buf = nullptr;
+        size_t len = 0;
+        auto out = open_memstream(&buf, &len);
+        parser p {[&](const request& req) { line(out, req); }};
+        p.on_body([](const request&, const char *, size_t) {});
+        p.feed(in.data(), in.size());
+        *err = p.error();
+        fclose(out);
+        std::string s {buf, len};
+        free(buf);
+        return s;
+}
+
+static std::string batched(const std::string& in, int threads,
+        parse_error *err, bool *ok)
+{
+        char *buf = nullptr;
+        size_t len = 0;
+        auto out = open_memstream(&buf, &len);
+        batch_stats stats;
+        *ok = batch_parse(in.data(), in.size(), threads, false, line, out,
+                &stats, err);
+        fclose(out);
+        std::string s {buf, len};
+        free(buf);
+        return s;
+}
+
+/*
+ * a capture cut into many pieces gives what one parser gives, in the
+ * same order, on any number of threads; so does the first error
+ */
+void test_batch(void)
+{
+        std::string in;
+        std::string body {"\r\n\r\nnot a request\r\n\r\nx"};
+        for (int i = 0; in.size() < 2 << 20; i++) {
+                in += "GET /" + std::to_string(i) + " HTTP/1.1\r\n"
+                        "Accept: text/html, */*;q=0.5\r\n\r\n";
+                /* bodies with blank lines of their own */
+                if (i % 7 == 0)
+                        in += "POST /p HTTP/1.1\r\nContent-Length: " +
+                                std::to_string(body.size()) + "\r\n\r\n" +
+                                body;
+                if (i % 11 == 0)
+                        in += "PUT /c HTTP/1.1\r\nTransfer-Encoding: "
+                                "chunked\r\n\r\n4\r\nbody\r\n0\r\n\r\n";
+        }
+
+        parse_error want, got;
+        auto seq = sequential(in, &want);
+        CHECK(want.code == ERR_NONE);
+        for (int threads : {1, 3, 8}) {
+                auto ok = false;
+                CHECK(batched(in, threads, &got, &ok) == seq);
+                CHECK(ok);
+        }
+
+        /* a bad request two thirds in */
+        auto bad = in.find("GET /", in.size() / 3 * 2);
+        in.insert(bad + 4, "\x01");
+        seq = sequential(in, &want);
+        CHECK(want.code == ERR_CHAR);
+        for (int threads : {1, 3, 8}) {
+                auto ok = true;
+                CHECK(batched(in, threads, &got, &ok) == seq);
+                CHECK(!ok);
+                CHECK(got.code == want.code && got.off == want.off);
+        }
+}
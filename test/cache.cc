@@ -0,0 +1,104 @@
+#include "cache.h"
+#include "check.h"
+#include <utility>
+
+/* the cache's answer, or -1 if the request didn't parse */
+static int look(response_cache& c, const char *in, bool lazy, uint64_t now)
+{
+        auto d = -1;
+        parse(in, lazy, [&](const request& req) {
+                cached_ptr out;
+                d = c.lookup(req, &out, now);
+                /* a response comes back whenever one is stored */
+                CHECK(d == CACHE_UNAVAILABLE || (out != nullptr) ==
+                        (d == CACHE_HIT || d == CACHE_REVALIDATE));
+        });
+        return d;
+}
+
+/* what lookup() said, then whether store() took the answer after it */
+static std::pair<int, bool> look_put(response_cache& c, const char *in,
+        bool lazy, uint64_t now)
+{
+        std::pair<int, bool> r {-1, false};
+        parse(in, lazy, [&](const request& req) {
+                cached_ptr out;
+                r.first = c.lookup(req, &out, now);
+                r.second = c.store(req, "HTTP/1.1 200 OK\r\n\r\n", 60, now);
+        });
+        return r;
+}
+
+static bool put(response_cache& c, const char *in, bool lazy, uint64_t now)
+{
+        auto ok = false;
+        parse(in, lazy, [&](const request& req) {
+                ok = c.store(req, "HTTP/1.1 200 OK\r\n\r\n", 60, now);
+        });
+        return ok;
+}
+
+#define GET(cc) "GET /a HTTP/1.1\r\nCache-Control: " cc "\r\n\r\n"
+
+void test_cache(void)
+{
+        for (auto lazy : {false, true}) {
+                response_cache c {4, 1 << 20};
+                CHECK(look(c, GET("public"), lazy, 0) == CACHE_MISS);
+                CHECK(put(c, "GET /a HTTP/1.1\r\n\r\n", lazy, 0));
+
+                /* stored for 60s */
+                CHECK(look(c, "GET /a HTTP/1.1\r\n\r\n", lazy, 30) ==
+                        CACHE_HIT);
+                CHECK(look(c, "GET /a?x HTTP/1.1\r\n\r\n", lazy, 30) ==
+                        CACHE_MISS);
+                CHECK(look(c, "GET /a HTTP/1.1\r\n\r\n", lazy, 70) ==
+                        CACHE_REVALIDATE);
+                CHECK(look(c, GET("no-cache"), lazy, 30) == CACHE_REVALIDATE);
+
+                /* max-age lowers the lifetime, min-fresh asks for more */
+                CHECK(look(c, GET("max-age=40"), lazy, 30) == CACHE_HIT);
+                CHECK(look(c, GET("max-age=10"), lazy, 30) ==
+                        CACHE_REVALIDATE);
+                CHECK(look(c, GET("min-fresh=20"), lazy, 30) == CACHE_HIT);
+                CHECK(look(c, GET("min-fresh=40"), lazy, 30) ==
+                        CACHE_REVALIDATE);
+
+                /* max-stale lets it be stale by so much, or by any */
+                CHECK(look(c, GET("max-stale=5"), lazy, 64) == CACHE_HIT);
+                CHECK(look(c, GET("max-stale=5"), lazy, 70) ==
+                        CACHE_REVALIDATE);
+                CHECK(look(c, GET("max-stale"), lazy, 700) == CACHE_HIT);
+                CHECK(look(c, GET("only-if-cached, max-stale=5"), lazy, 70) ==
+                        CACHE_UNAVAILABLE);
+                CHECK(look(c, GET("only-if-cached, no-cache"), lazy, 30) ==
+                        CACHE_HIT);
+                CHECK(look(c, "GET /b HTTP/1.1\r\n"
+                        "Cache-Control: only-if-cached\r\n\r\n", lazy, 30) ==
+                        CACHE_UNAVAILABLE);
+
+                /* no-store, or a Cache-Control that doesn't parse */
+                CHECK(!put(c, "GET /b HTTP/1.1\r\n"
+                        "Cache-Control: no-store\r\n\r\n", lazy, 0));
+                CHECK(look(c, GET("no-store"), lazy, 30) == CACHE_MISS);
+                CHECK(!put(c, "GET /b HTTP/1.1\r\n"
+                        "Cache-Control: max-age=abc\r\n\r\n", lazy, 0));
+                /* an eager parser refuses the request outright */
+                CHECK(look(c, GET("max-age=abc"), lazy, 30) ==
+                        (lazy ? CACHE_MISS : -1));
+                /* nor after lookup() has tried to parse it already */
+                auto r = look_put(c, "GET /b HTTP/1.1\r\nCache-Control: "
+                        "max-age=abc, no-store\r\n\r\n", lazy, 0);
+                CHECK(r.first == (lazy ? CACHE_MISS : -1));
+                CHECK(!r.second);
+                CHECK(look(c, "GET /b HTTP/1.1\r\n\r\n", lazy, 30) ==
+                        CACHE_MISS);
+
+                /* a POST drops what GET had stored */
+                CHECK(!put(c, "POST /a HTTP/1.1\r\n\r\n", lazy, 0));
+                CHECK(look(c, "POST /a HTTP/1.1\r\n\r\n", lazy, 30) ==
+                        CACHE_MISS);
+                CHECK(look(c, "GET /a HTTP/1.1\r\n\r\n", lazy, 30) ==
+                        CACHE_MISS);
+        }
+}
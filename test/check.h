@@ -0,0 +1,36 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include "parser.h"
+#include <cstdio>
+
+/*
+ * behaviour checks for make test. a failed CHECK says where and
+ * carries on, so one run reports every check that fails.
+ */
+extern int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+                fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+                failures++; \
+        } \
+} while (0)
+
+int parse(const char *in, bool lazy, const request_cb& fn);
+
+void test_method(void);
+void test_negotiate(void);
+void test_rewrite(void);
+void test_cache(void);
+void test_parser(void);
+void test_path(void);
+void test_router(void);
+void test_scan(void);
+void test_lexer(void);
+void test_decode(void);
+void test_batch(void);
+void test_number(void);
+void test_column(void);
+
+#endif
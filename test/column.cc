@@ -0,0 +1,102 @@
+#include "check.h"
+#include "column.h"
+#include <string>
+#include <vector>
+
+/* what a row should read back as */
+struct row {
+        std::string method, path;
+        uint64_t len, seen;
+        uint32_t cache, max_age;
+        std::vector<std::string> names;
+        std::vector<std::string> accept;
+        std::vector<uint16_t> q;
+};
+
+static std::string str(span s)
+{
+        return std::string(s.data(), s.size());
+}
+
+/*
+ * enough requests for three blocks, written and read back. names
+ * come in mixed case and must read back in lower case; values, and
+ * CONNECT's path, may be empty.
+ */
+void test_column(void)
+{
+        static const size_t ROWS {column_writer::BLOCK * 2 + 100};
+        std::string in;
+        std::vector<row> want;
+        for (size_t i = 0; i < ROWS; i++) {
+                auto n = std::to_string(i % 500);
+                if (i % 9 == 0) {
+                        in += "CONNECT h" + n + ":443 HTTP/1.1\r\n"
+                                "X-Empty:\r\n\r\n";
+                        want.push_back(row{"CONNECT", "", 0, 0, 0, 0,
+                                {"x-empty"}, {}, {}});
+                        continue;
+                }
+                in += "GET /p/" + n + " HTTP/1.1\r\n" +
+                        (i % 2 ? "X-Mixed-Case" : "x-mixed-CASE") + ": " +
+                        n + "\r\nCONTENT-length: " +
+                        std::to_string(i % 50) + "\r\n"
+                        "Cache-Control: max-age=" + n + "\r\n"
+                        "Accept: text/html;q=0.5, */*\r\n"
+                        "x-blank: \r\n\r\n" + std::string(i % 50, 'b');
+                want.push_back(row{"GET", "/p/" + n, i % 50,
+                        uint64_t{1} << TOK_CONTENT_LENGTH |
+                        uint64_t{1} << TOK_CACHE_CONTROL |
+                        uint64_t{1} << TOK_ACCEPT,
+                        uint32_t{1} << CC_MAX_AGE,
+                        static_cast<uint32_t>(i % 500),
+                        {"x-mixed-case", "content-length", "cache-control",
+                                "accept", "x-blank"},
+                        {"text/html", "*/*"}, {500, 1000}});
+        }
+
+        auto fp = tmpfile();
+        column_writer w;
+        size_t got = 0;
+        parser p {[&](const request& req) {
+                got++;
+                CHECK(w.add(fp, req));
+        }};
+        p.on_body([](const request&, const char *, size_t) {});
+        CHECK(p.feed(in.data(), in.size()) == PARSE_NEED_MORE);
+        CHECK(got == ROWS);
+        CHECK(w.flush(fp));
+        rewind(fp);
+
+        column_reader r {fp};
+        size_t blocks = 0, at = 0;
+        while (r.next()) {
+                blocks++;
+                for (size_t i = 0; i < r.rows() && at < ROWS; i++, at++) {
+                        auto& x = want[at];
+                        CHECK(str(r.method(i)) == x.method);
+                        CHECK(str(r.path(i)) == x.path);
+                        CHECK(r.major(i) == 1 && r.minor(i) == 1);
+                        CHECK(r.length(i) == x.len);
+                        CHECK(r.seen(i) == x.seen);
+                        CHECK(r.cache(i) == x.cache);
+                        CHECK(r.max_age(i) == x.max_age);
+                        CHECK(r.fields(i) == x.names.size());
+                        for (size_t k = 0; k < r.fields(i) &&
+                            k < x.names.size(); k++)
+                                CHECK(str(r.string(r.field_name(i, k))) ==
+                                        x.names[k]);
+                        CHECK(r.accepts(i) == x.accept.size());
+                        for (size_t k = 0; k < r.accepts(i) &&
+                            k < x.accept.size(); k++) {
+                                CHECK(str(r.string(r.accept_type(i, k))) ==
+                                        x.accept[k]);
+                                CHECK(r.accept_q(i, k) == x.q[k]);
+                        }
+                }
+        }
+        CHECK(!r.bad());
+        CHECK(blocks == 3);
+        CHECK(at == ROWS);
+        fclose(fp);
+}
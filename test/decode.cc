@@ -0,0 +1,184 @@
+#include "check.h"
+#include "decode.h"
+#include "md5.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <zlib.h>
+
+static std::string hex(const char *in, size_t n, size_t split)
+{
+        md5 m;
+        for (size_t i = 0; i < n; i += split)
+                m.update(in + i, n - i < split ? n - i : split);
+        unsigned char d[md5::SIZE];
+        m.digest(d);
+        std::string s;
+        for (auto b : d) {
+                s += "0123456789abcdef"[b >> 4];
+                s += "0123456789abcdef"[b & 15];
+        }
+        return s;
+}
+
+/* the test suite of RFC 1321, A.5, whole and in pieces */
+static void test_md5(void)
+{
+        static const struct {
+                const char *in, *out;
+        } suite[] {
+                {"", "d41d8cd98f00b204e9800998ecf8427e"},
+                {"a", "0cc175b9c0f1b6a831c399e269772661"},
+                {"abc", "900150983cd24fb0d6963f7d28e17f72"},
+                {"message digest", "f96b697d7cb7938d525a2f31aaf161d0"},
+                {"abcdefghijklmnopqrstuvwxyz",
+                        "c3fcd3d76192e4007dfb496cca67e13b"},
+                {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                        "0123456789", "d174ab98d277d9f5a5611c2c9f419d9f"},
+                {"1234567890123456789012345678901234567890123456789012345"
+                        "6789012345678901234567890",
+                        "57edf4a22be3c955ac49da2e2107b67a"},
+        };
+        for (auto& t : suite) {
+                auto n = strlen(t.in);
+                for (size_t split : {size_t{1}, size_t{7}, size_t{63},
+                                size_t{64}, n + 1})
+                        CHECK(hex(t.in, n, split) == t.out);
+        }
+}
+
+static std::string base64(const unsigned char *p, size_t n)
+{
+        static const char abc[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                "abcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string s;
+        for (size_t i = 0; i < n; i += 3) {
+                uint32_t v = p[i] << 16;
+                if (i + 1 < n)
+                        v |= p[i + 1] << 8;
+                if (i + 2 < n)
+                        v |= p[i + 2];
+                s += abc[v >> 18 & 63];
+                s += abc[v >> 12 & 63];
+                s += i + 1 < n ? abc[v >> 6 & 63] : '=';
+                s += i + 2 < n ? abc[v & 63] : '=';
+        }
+        return s;
+}
+
+/* s as Content-MD5 has it */
+static std::string digest(const std::string& s)
+{
+        md5 m;
+        m.update(s.data(), s.size());
+        unsigned char d[md5::SIZE];
+        m.digest(d);
+        return base64(d, sizeof(d));
+}
+
+/* s compressed into the gzip format, or zlib's for deflate */
+static std::string compress(const std::string& s, bool gzip)
+{
+        z_stream z {};
+        CHECK(deflateInit2(&z, 6, Z_DEFLATED, gzip ? 15 + 16 : 15, 8,
+                Z_DEFAULT_STRATEGY) == Z_OK);
+        std::string out(deflateBound(&z, s.size()), '\0');
+        z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(s.data()));
+        z.avail_in = s.size();
+        z.next_out = reinterpret_cast<Bytef *>(&out[0]);
+        z.avail_out = out.size();
+        CHECK(deflate(&z, Z_FINISH) == Z_STREAM_END);
+        out.resize(z.total_out);
+        deflateEnd(&z);
+        return out;
+}
+
+struct decoded {
+        std::string body;
+        int err;
+        int ends;
+};
+
+/*
+ * a POST with body and the given extra headers through a parser and
+ * a body_decoder, fed in pieces of split bytes
+ */
+static decoded post(const std::string& hdrs, const std::string& body,
+        size_t split)
+{
+        decoded d {"", ERR_NONE, 0};
+        body_decoder *dec = nullptr;
+        body_decoder out {[&](const request&, const char *b, size_t n) {
+                if (b != nullptr) {
+                        d.body.append(b, n);
+                        return;
+                }
+                d.err = dec->error();
+                d.ends++;
+        }};
+        dec = &out;
+
+        parser p {[](const request&) {}};
+        p.on_body([&](const request& req, const char *b, size_t n) {
+                out.feed(req, b, n);
+        });
+        auto in = "POST /a HTTP/1.1\r\n" + hdrs + "Content-Length: " +
+                std::to_string(body.size()) + "\r\n\r\n" + body;
+        for (size_t i = 0; i < in.size(); i += split)
+                p.feed(in.data() + i, std::min(split, in.size() - i));
+        CHECK(p.state() == PARSE_NEED_MORE);
+        return d;
+}
+
+/* round trips through body_decoder, and bodies it must refuse */
+static void test_decoder(void)
+{
+        std::string text;
+        uint32_t seed {12345};
+        /* long enough to come out in several of the decoder's chunks */
+        while (text.size() < 100000) {
+                seed = seed * 1103515245 + 12345;
+                text += "line " + std::to_string(seed >> 20) +
+                        " of the body\n";
+        }
+        auto gz = compress(text, true);
+        auto zl = compress(text, false);
+
+        for (size_t split : {size_t{1000}, size_t{65536}}) {
+                auto d = post("Content-Encoding: gzip\r\nContent-MD5: " +
+                        digest(gz) + "\r\n", gz, split);
+                CHECK(d.err == ERR_NONE && d.ends == 1 && d.body == text);
+
+                d = post("Content-Encoding: deflate\r\n", zl, split);
+                CHECK(d.err == ERR_NONE && d.ends == 1 && d.body == text);
+
+                d = post("Content-MD5: " + digest(text) + "\r\n", text,
+                        split);
+                CHECK(d.err == ERR_NONE && d.ends == 1 && d.body == text);
+
+                /* the digest is of the body as sent, not as decoded */
+                d = post("Content-Encoding: gzip\r\nContent-MD5: " +
+                        digest(text) + "\r\n", gz, split);
+                CHECK(d.err == ERR_DIGEST && d.ends == 1);
+                d = post("Content-MD5: " + digest(text + "!") + "\r\n",
+                        text, split);
+                CHECK(d.err == ERR_DIGEST && d.ends == 1);
+                d = post("Content-MD5: abc\r\n", text, split);
+                CHECK(d.err == ERR_DIGEST && d.ends == 1);
+
+                /* cut short, not compressed, or a coding we can't undo */
+                d = post("Content-Encoding: gzip\r\n", gz.substr(0, 5000),
+                        split);
+                CHECK(d.err == ERR_CODING && d.ends == 1);
+                d = post("Content-Encoding: gzip\r\n", text, split);
+                CHECK(d.err == ERR_CODING && d.ends == 1);
+                d = post("Content-Encoding: br\r\n", gz, split);
+                CHECK(d.err == ERR_CODING && d.body.empty());
+        }
+}
+
+void test_decode(void)
+{
+        test_md5();
+        test_decoder();
+}
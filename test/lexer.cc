@@ -0,0 +1,331 @@
+#include "check.h"
+#include "header.h"
+#include "lexer.h"
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * the lexer as it was before the DFA: a byte at a time, a mode
+ * variable and ctype calls, with the token rules added since. it is
+ * slow and obvious, which is the point; the DFA lexer has to give
+ * the same tokens and stop at the same error on any input.
+ */
+class oracle {
+private:
+        enum {
+                M_REQLINE = LEX_REQLINE,
+                M_HEADER = LEX_HEADER,
+                M_VALUE = LEX_VALUE,
+                M_FIELD,
+                M_RAW,
+                M_TARGET,
+        };
+        const char *_buf;
+        size_t _len;
+        size_t _pos {0};
+        int _mode;
+        std::vector<token> _out {};
+
+        int at(size_t i) const
+        {
+                return static_cast<unsigned char>(_buf[i]);
+        }
+
+        bool alpha(size_t i) const
+        {
+                return i < _len && isalpha(at(i));
+        }
+
+        bool digit(size_t i) const
+        {
+                return i < _len && isdigit(at(i));
+        }
+
+        bool tchar(size_t i) const
+        {
+                return i < _len && (isalnum(at(i)) || (at(i) != 0 &&
+                        strchr("!#$%&'*+-.^_`|~", at(i)) != nullptr));
+        }
+
+        bool ctl(size_t i) const
+        {
+                return (at(i) < ' ' && at(i) != '\t') || at(i) == 0x7f;
+        }
+
+        void emit(int type, size_t off, size_t len)
+        {
+                _out.push_back(token{type, off, len});
+        }
+
+        bool fail(int code, size_t off)
+        {
+                err = parse_error{code, off, TOK_EOF, TOK_EOF};
+                return false;
+        }
+
+        bool step(void);
+public:
+        parse_error err {ERR_NONE, 0, TOK_EOF, TOK_EOF};
+
+        oracle(const char *buf, size_t len, int mode)
+                : _buf {buf}, _len {len}, _mode {mode}
+        {
+        }
+
+        /* every token up to EOF, or up to a TOK_EOL at the error */
+        const std::vector<token>& run(void)
+        {
+                while (step()) {
+                        if (_out.back().type() == TOK_EOF)
+                                return _out;
+                }
+                emit(TOK_EOL, err.off, 0);
+                return _out;
+        }
+};
+
+bool oracle::step(void)
+{
+        while (_pos < _len && at(_pos) == ' ' && _mode != M_HEADER &&
+            _mode != M_FIELD)
+                _pos++;
+        if (_pos == _len) {
+                emit(TOK_EOF, _pos, 0);
+                return true;
+        }
+
+        auto start = _pos;
+        int c = at(_pos++);
+
+        if (c == '\r') {
+                if (_pos == _len || at(_pos) != '\n')
+                        return fail(ERR_CRLF, start);
+                _pos++;
+                _mode = M_HEADER;
+                emit(TOK_EOL, start, 2);
+                return true;
+        }
+
+        if (_mode == M_RAW) {
+                if (ctl(start))
+                        return fail(ERR_CHAR, start);
+                while (_pos < _len && !ctl(_pos))
+                        _pos++;
+                if (_pos < _len && at(_pos) != '\r')
+                        return fail(ERR_CHAR, _pos);
+                emit(TOK_STR, start, _pos - start);
+                return true;
+        }
+
+        if (_mode == M_FIELD && c == ':') {
+                _mode = M_RAW;
+                emit(TOK_COLON, start, 1);
+                return true;
+        }
+
+        if ((_mode == M_HEADER || _mode == M_FIELD) && tchar(start)) {
+                while (tchar(_pos))
+                        _pos++;
+                auto n = _pos - start;
+                auto type = header_lookup(_buf + start, n);
+                _mode = type < 0 ? M_FIELD : M_HEADER;
+                emit(type < 0 ? TOK_FIELD : type, start, n);
+                return true;
+        }
+
+        if (_mode == M_TARGET && c > ' ' && c < 0x7f) {
+                while (_pos < _len && at(_pos) > ' ' && at(_pos) < 0x7f)
+                        _pos++;
+                _mode = M_REQLINE;
+                emit(TOK_PATH, start, _pos - start);
+                return true;
+        }
+
+        if (c == '"') {
+                while (_pos < _len && at(_pos) != '"')
+                        _pos++;
+                if (_pos == _len)
+                        return fail(ERR_STRING, start);
+                _pos++;
+                emit(TOK_STR, start + 1, _pos - start - 2);
+                return true;
+        }
+
+        auto p = strchr("/:.=,;", c);
+        if (c != 0 && p != nullptr) {
+                static const int types[] {TOK_SLASH, TOK_COLON, TOK_DOT,
+                        TOK_EQ, TOK_COMMA, TOK_SEMI};
+                if (_mode == M_FIELD)
+                        _mode = M_HEADER;
+                else if (_mode == M_HEADER && c == ':')
+                        _mode = M_VALUE;
+                emit(types[p - "/:.=,;"], start, 1);
+                return true;
+        }
+
+        if (_mode == M_REQLINE && alpha(start)) {
+                while (alpha(_pos))
+                        _pos++;
+                auto n = _pos - start;
+                if (n == 4 && memcmp(_buf + start, "HTTP", 4) == 0) {
+                        emit(TOK_HTTP, start, n);
+                } else {
+                        _mode = M_TARGET;
+                        emit(TOK_METHOD, start, n);
+                }
+                return true;
+        }
+
+        if (alpha(start) || (_mode == M_VALUE && (c == '-' || c == '*'))) {
+                while (alpha(_pos) || digit(_pos) ||
+                    (_pos < _len && (at(_pos) == '-' || at(_pos) == '*')))
+                        _pos++;
+                emit(TOK_WORD, start, _pos - start);
+                return true;
+        }
+
+        if (digit(start)) {
+                while (digit(_pos))
+                        _pos++;
+                if (_pos < _len && at(_pos) == '.') {
+                        _pos++;
+                        while (digit(_pos))
+                                _pos++;
+                }
+                emit(TOK_NUM, start, _pos - start);
+                return true;
+        }
+
+        return fail(ERR_CHAR, start);
+}
+
+static bool same(const token& a, const token& b)
+{
+        return a.type() == b.type() && a.off() == b.off() &&
+                a.len() == b.len();
+}
+
+/*
+ * lex in with the DFA lexer twice, once with next() and once with
+ * tokenize() a few tokens at a time, and with the oracle. false, with
+ * the input printed, on the first difference.
+ */
+static bool agree(const std::string& in, int mode)
+{
+        oracle o {in.data(), in.size(), mode};
+        auto& want = o.run();
+
+        std::vector<token> got;
+        lexer lx {in.data(), in.size(), mode};
+        do {
+                got.push_back(lx.next());
+        } while (got.back().type() != TOK_EOF && lx.error().code == ERR_NONE);
+
+        std::vector<token> run;
+        lexer lt {in.data(), in.size(), mode};
+        token buf[5];
+        size_t n;
+        while ((n = lt.tokenize(buf, 5)) != 0) {
+                run.insert(run.end(), buf, buf + n);
+                if (run.back().type() == TOK_EOF ||
+                    lt.error().code != ERR_NONE)
+                        break;
+        }
+
+        auto ok = got.size() == want.size() && run.size() == want.size() &&
+                lx.error().code == o.err.code &&
+                lt.error().code == o.err.code;
+        for (size_t i = 0; ok && i < want.size(); i++)
+                ok = same(got[i], want[i]) && same(run[i], want[i]);
+        if (o.err.code != ERR_NONE && ok)
+                ok = lx.error().off == o.err.off && lt.error().off == o.err.off;
+        if (!ok) {
+                fprintf(stderr, "lexers differ in mode %d on:\n", mode);
+                for (auto c : in)
+                        fprintf(stderr, isprint((unsigned char)c) ? "%c" :
+                                "\\x%02x", (unsigned char)c);
+                fprintf(stderr, "\n");
+        }
+        return ok;
+}
+
+static uint32_t rnd(uint32_t& s)
+{
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        return s;
+}
+
+static const char *seeds[] {
+        "GET /a/b.html?q=1 HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "Accept: text/html;q=0.9, */*;q=0.1\r\n"
+        "Accept-Language: en-US, fr;q=0.5\r\n"
+        "Cache-Control: max-age=60, no-cache=\"x\"\r\n"
+        "Content-Length: 12\r\n"
+        "\r\n",
+        "POST  http://h:80/x  HTTP/1.0\r\n"
+        "Transfer-Encoding: gzip, chunked\r\n"
+        "X-Custom: \"anything\" at\tall ;,=\r\n"
+        "Content-MD5: Q2hlY2sgSW50ZWdyaXR5IQ==\r\n"
+        "Authorization: Basic dXNlcjpwYXNz\r\n"
+        "\r\n",
+        "CONNECT h.example:443 HTTP/1.1\r\n"
+        "connection: keep-alive\r\n"
+        "accept-encoding: br;q=1.0, identity;q=0\r\n"
+        "x-odd.name!: v\r\n"
+        "\r\n",
+};
+
+/* bytes worth dropping into a request */
+static const char pool[] = " \r\n\t:/.,;=\"-*!aZ09\x01\x7f\x80\xff";
+
+/*
+ * the seeds as they are, then mutated: bytes replaced, inserted and
+ * deleted, cut short, or runs of them repeated. every input is lexed
+ * from each of the three starting modes.
+ */
+void test_lexer(void)
+{
+        static const int ROUNDS {30000};
+        static const size_t NSEEDS {sizeof(seeds) / sizeof(*seeds)};
+        uint32_t seed {0x2545f491};
+        auto fails = failures;
+
+        for (auto s : seeds) {
+                for (int mode : {LEX_REQLINE, LEX_HEADER, LEX_VALUE})
+                        CHECK(agree(s, mode));
+        }
+
+        for (int r = 0; r < ROUNDS && failures - fails < 10; r++) {
+                std::string in {seeds[rnd(seed) % NSEEDS]};
+                for (int k = rnd(seed) % 4 + 1; k > 0; k--) {
+                        auto i = rnd(seed) % (in.size() + 1);
+                        auto c = pool[rnd(seed) % (sizeof(pool) - 1)];
+                        switch (rnd(seed) % 5) {
+                        case 0:
+                                if (i < in.size())
+                                        in[i] = c;
+                                break;
+                        case 1:
+                                in.insert(i, 1, c);
+                                break;
+                        case 2:
+                                in.erase(i, 1);
+                                break;
+                        case 3:
+                                in.resize(i);
+                                break;
+                        default:
+                                in.insert(i, in.substr(i, rnd(seed) % 8));
+                                break;
+                        }
+                }
+                for (int mode : {LEX_REQLINE, LEX_HEADER, LEX_VALUE})
+                        CHECK(agree(in, mode));
+        }
+}
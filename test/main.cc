@@ -0,0 +1,41 @@
+#include "check.h"
+#include <cstring>
+
+int failures;
+
+/*
+ * feed in to a parser a byte at a time, so every check also crosses
+ * every split point, and hand each request to fn. returns the
+ * parser's state at the end.
+ */
+int parse(const char *in, bool lazy, const request_cb& fn)
+{
+        parser p {fn, lazy};
+        auto n = strlen(in);
+        for (size_t i = 0; i < n && p.state() != PARSE_ERROR; i++)
+                p.feed(in + i, 1);
+        return p.state();
+}
+
+int main(void)
+{
+        test_method();
+        test_number();
+        test_negotiate();
+        test_rewrite();
+        test_cache();
+        test_parser();
+        test_path();
+        test_router();
+        test_scan();
+        test_lexer();
+        test_decode();
+        test_batch();
+        test_column();
+
+        if (failures != 0) {
+                fprintf(stderr, "%d checks failed\n", failures);
+                return 1;
+        }
+        printf("all checks passed\n");
+}
@@ -0,0 +1,21 @@
+#include "check.h"
+#include "header.h"
+#include <cstring>
+
+static int lookup(const char *name)
+{
+        return method_lookup(name, strlen(name));
+}
+
+void test_method(void)
+{
+        for (int m = METHOD_OTHER + 1; m < METHOD_COUNT; m++)
+                CHECK(lookup(method_name(m)) == m);
+
+        /* case matters, and so does every byte */
+        for (auto s : {"get", "Get", "GETS", "GE", "PUTT", "POS", "POSTS",
+                        "HEAD ", "PATCHX", "TRACX", "DELETED", "OPTION",
+                        "CONNEC", "XONNECT", "OPTIONZ", "X", ""})
+                CHECK(lookup(s) == METHOD_OTHER);
+        CHECK(method_name(METHOD_OTHER) == nullptr);
+}
@@ -0,0 +1,53 @@
+#include "check.h"
+#include "negotiate.h"
+
+static const char RANKED[] {
+        "GET / HTTP/1.1\r\n"
+        "Accept: text/*;q=0.3, text/html;q=0.7, */*;q=0.5\r\n"
+        "Accept-Language: da, en-gb;q=0.8, en;q=0.7\r\n"
+        "Accept-Encoding: gzip;q=0\r\n"
+        "\r\n"};
+
+static const char REFUSED[] {
+        "GET / HTTP/1.1\r\n"
+        "Accept: text/plain;q=0, */*\r\n"
+        "Accept-Encoding: *;q=0\r\n"
+        "\r\n"};
+
+void test_negotiate(void)
+{
+        for (auto lazy : {false, true}) {
+                negotiator n {64};
+                parse(RANKED, lazy, [&](const request& req) {
+                        /* the most specific range gives an offer its q */
+                        CHECK(n.best(req, TOK_ACCEPT, {"text/plain",
+                                "text/html", "image/png"}) == 1);
+                        CHECK(n.best(req, TOK_ACCEPT, {"text/plain",
+                                "image/png"}) == 1);
+                        CHECK(negotiate_media(req, {"text/plain",
+                                "image/png"}) == 1);
+                        CHECK(n.best(req, TOK_ACCEPT_LANGUAGE, {"fr",
+                                "en-US", "en-GB"}) == 2);
+                        CHECK(n.best(req, TOK_ACCEPT_LANGUAGE, {"fr"}) == -1);
+                        /* q=0 refuses; identity stays acceptable */
+                        CHECK(n.best(req, TOK_ACCEPT_ENCODING, {"gzip"}) == -1);
+                        CHECK(n.best(req, TOK_ACCEPT_ENCODING, {"gzip",
+                                "identity"}) == 1);
+                        /* no header: the first offer */
+                        CHECK(n.best(req, TOK_ACCEPT_CHARSET, {"utf-8",
+                                "iso-8859-1"}) == 0);
+                        /* asked again, the answer comes from the cache */
+                        auto hits = n.hits();
+                        CHECK(n.best(req, TOK_ACCEPT, {"text/plain",
+                                "text/html", "image/png"}) == 1);
+                        CHECK(n.hits() == hits + 1);
+                });
+                parse(REFUSED, lazy, [&](const request& req) {
+                        CHECK(n.best(req, TOK_ACCEPT, {"text/plain",
+                                "text/html"}) == 1);
+                        CHECK(n.best(req, TOK_ACCEPT, {"text/plain"}) == -1);
+                        CHECK(n.best(req, TOK_ACCEPT_ENCODING,
+                                {"identity"}) == -1);
+                });
+        }
+}
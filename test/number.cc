@@ -0,0 +1,67 @@
+#include "check.h"
+#include "number.h"
+#include <cstring>
+
+static const uint16_t BAD_Q {9999};
+static const uint64_t BAD {12345};
+
+/* what s parses to, or the BAD value left alone when it doesn't */
+static uint16_t q(const char *s)
+{
+        uint16_t v = BAD_Q;
+        auto ok = parse_qvalue(span{s, strlen(s)}, &v);
+        CHECK(ok == (v != BAD_Q));
+        return v;
+}
+
+static uint64_t u64(const char *s)
+{
+        uint64_t v = BAD;
+        auto ok = parse_u64(span{s, strlen(s)}, &v);
+        CHECK(ok == (v != BAD));
+        return v;
+}
+
+static uint64_t delta(const char *s)
+{
+        uint32_t v = BAD;
+        auto ok = parse_delta(span{s, strlen(s)}, &v);
+        CHECK(ok == (v != BAD));
+        return v;
+}
+
+void test_number(void)
+{
+        /* up to three decimals, and nothing over 1 */
+        CHECK(q("1") == 1000);
+        CHECK(q("1.") == 1000);
+        CHECK(q("1.000") == 1000);
+        CHECK(q("0") == 0);
+        CHECK(q("0.000") == 0);
+        CHECK(q("0.5") == 500);
+        CHECK(q("0.05") == 50);
+        CHECK(q("0.001") == 1);
+        CHECK(q("0.999") == 999);
+        for (auto s : {"", "0.0001", "1.0000", "1.001", "1.5", "2", ".5",
+                        "00", "0,5", "0.5x", "-0", " 1"})
+                CHECK(q(s) == BAD_Q);
+
+        /* all of 64 bits and not one more */
+        CHECK(u64("0") == 0);
+        CHECK(u64("00012") == 12);
+        CHECK(u64("18446744073709551615") == UINT64_MAX);
+        for (auto s : {"", "18446744073709551616", "99999999999999999999",
+                        "184467440737095516150", "-1", "+1", "1 ", "0x10",
+                        "1.0"})
+                CHECK(u64(s) == BAD);
+
+        /* anything past 2^31 is 2^31, however long */
+        CHECK(delta("0") == 0);
+        CHECK(delta("60") == 60);
+        CHECK(delta("2147483647") == 2147483647);
+        CHECK(delta("2147483648") == 2147483648);
+        CHECK(delta("2147483649") == 2147483648);
+        CHECK(delta("99999999999999999999999999") == 2147483648);
+        for (auto s : {"", "-1", "1.5", "abc", "60 ", "9999999999x"})
+                CHECK(delta(s) == BAD);
+}
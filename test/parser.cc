@@ -0,0 +1,170 @@
+#include "check.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+/*
+ * the paths of the requests in, then the error that stopped them if
+ * one did. fed a byte at a time like parse().
+ */
+static std::string paths(const char *in, bool lazy = false)
+{
+        std::string s;
+        parser p {[&](const request& req) {
+                s += std::string(req.path.data(), req.path.size()) + " ";
+        }, lazy};
+        p.on_body([](const request&, const char *, size_t) {});
+        for (size_t i = 0; i < strlen(in) && p.state() != PARSE_ERROR; i++)
+                p.feed(in + i, 1);
+        if (p.state() == PARSE_ERROR)
+                s += error_name(p.error().code);
+        return s;
+}
+
+/* a head that never ends is cut off at the limit */
+static void test_limit(void)
+{
+        parser p;
+        p.max_head(100);
+        std::string head {"GET /a HTTP/1.1\r\nX-A: "};
+        CHECK(p.feed(head.data(), head.size()) == PARSE_NEED_MORE);
+        std::string junk(80, 'x');
+        CHECK(p.feed(junk.data(), junk.size()) == PARSE_ERROR);
+        CHECK(p.error().code == ERR_TOO_LONG);
+        CHECK(p.error().off == 100);
+
+        /* as is a chunk size line */
+        p.reset();
+        std::string in {"POST /a HTTP/1.1\r\nTransfer-Encoding: chunked"
+                "\r\n\r\n"};
+        CHECK(p.feed(in.data(), in.size()) == PARSE_DONE);
+        CHECK(p.next() == PARSE_NEED_MORE);
+        in.assign(200, '0');
+        CHECK(p.feed(in.data(), in.size()) == PARSE_ERROR);
+        CHECK(p.error().code == ERR_TOO_LONG);
+
+        /* the default leaves room for any sane head */
+        CHECK(paths(("GET /a HTTP/1.1\r\nX-A: " + std::string(60000, 'x') +
+                "\r\n\r\n").c_str()) == "/a ");
+        CHECK(paths(("GET /a HTTP/1.1\r\nX-A: " + std::string(70000, 'x') +
+                "\r\n\r\n").c_str()) == "head or line too long");
+}
+
+/*
+ * fed in windows, only a request cut by a window's end is copied:
+ * every other one is parsed, and its body handed on, where it lies
+ */
+static void test_in_place(void)
+{
+        std::string in;
+        for (int i = 0; i < 2000; i++) {
+                in += "POST /" + std::to_string(i) + " HTTP/1.1\r\n"
+                        "Host: x\r\n";
+                if (i % 2 == 0) {
+                        in += "Content-Length: 11\r\n\r\nhello world";
+                } else {
+                        in += "Transfer-Encoding: chunked\r\n\r\n"
+                                "5\r\nhello\r\n0\r\n\r\n";
+                }
+        }
+
+        for (size_t window : {size_t{1000}, size_t{4096}, size_t{65536}}) {
+                const char *lo = nullptr, *hi = nullptr;
+                size_t requests = 0, copied = 0, body = 0, moved = 0;
+                auto outside = [&](const char *p) {
+                        return p < lo || p >= hi;
+                };
+                parser p {[&](const request& req) {
+                        requests++;
+                        copied += outside(req.raw);
+                }};
+                p.on_body([&](const request&, const char *b, size_t n) {
+                        body += n;
+                        moved += b != nullptr && outside(b);
+                });
+                size_t windows = 0;
+                for (size_t off = 0; off < in.size(); off += window) {
+                        auto n = std::min(window, in.size() - off);
+                        /* each window in its own copy, as a read would */
+                        std::string w {in.data() + off, n};
+                        lo = w.data();
+                        hi = w.data() + n;
+                        CHECK(p.feed(w.data(), n) == PARSE_NEED_MORE);
+                        windows++;
+                }
+                CHECK(requests == 2000);
+                CHECK(body == 1000 * 11 + 1000 * 5);
+                CHECK(copied < windows);
+                CHECK(moved < windows);
+        }
+}
+
+/* a lazy value that fails to parse fails every load(), not just the first */
+static void test_load(void)
+{
+        int loaded = 0;
+        CHECK(parse("GET /a HTTP/1.1\r\nAccept: text/html, 1/\r\n\r\n",
+                true, [&](const request& req) {
+                loaded += req.load(TOK_ACCEPT);
+                loaded += req.load(TOK_ACCEPT);
+                loaded += req.src->load(TOK_ACCEPT);
+        }) == PARSE_NEED_MORE);
+        CHECK(loaded == 0);
+}
+
+void test_parser(void)
+{
+        test_in_place();
+        test_limit();
+        test_load();
+
+        /* stray CRLFs before a request line are skipped */
+        CHECK(paths("\r\nGET /a HTTP/1.1\r\n\r\n") == "/a ");
+        CHECK(paths("GET /a HTTP/1.1\r\nContent-Length: 1\r\n\r\nx\r\n"
+                "\r\nGET /b HTTP/1.1\r\n\r\n") == "/a /b ");
+
+        for (auto lazy : {false, true}) {
+                /* a repeated Content-Length has to agree */
+                CHECK(paths("POST /a HTTP/1.1\r\nContent-Length: 5\r\n"
+                        "Content-Length: 100\r\n\r\nhello", lazy) ==
+                        "bad message framing");
+                CHECK(paths("POST /a HTTP/1.1\r\nContent-Length: 5\r\n"
+                        "Content-Length: 5\r\n\r\nhelloGET /b HTTP/1.1"
+                        "\r\n\r\n", lazy) == "/a /b ");
+
+                /* transfer codings are named without regard to case */
+                CHECK(paths("POST /a HTTP/1.1\r\nTransfer-Encoding: "
+                        "Chunked\r\n\r\n1\r\nx\r\n0\r\n\r\n", lazy) ==
+                        "/a ");
+                CHECK(paths("POST /a HTTP/1.1\r\nTransfer-Encoding: "
+                        "gzip\r\n\r\n", lazy) == "bad message framing");
+
+                /* a chunk size has digits; blanks alone are no last chunk */
+                for (auto size : {" ", "\t;x", ";x", ""})
+                        CHECK(paths(("POST /a HTTP/1.1\r\nTransfer-Encoding: "
+                                "chunked\r\n\r\n" + std::string(size) +
+                                "\r\n\r\n").c_str(), lazy) ==
+                                "/a malformed chunk");
+                CHECK(paths("POST /a HTTP/1.1\r\nTransfer-Encoding: "
+                        "chunked\r\n\r\n0 ;x\r\n\r\n", lazy) == "/a ");
+
+                /* no control characters but HTAB in any value */
+                CHECK(paths("GET /a HTTP/1.1\r\nX-A: b\nc\r\n\r\n", lazy) ==
+                        "bad character");
+                CHECK(paths("GET /a HTTP/1.1\r\nX-A: b\x01\r\n\r\n", lazy) ==
+                        "bad character");
+                CHECK(paths("GET /a HTTP/1.1\r\nX-A: \x7f\r\n\r\n", lazy) ==
+                        "bad character");
+                CHECK(paths("GET /a HTTP/1.1\r\nAccept: a\x01\r\n\r\n",
+                        lazy) == "bad character");
+                CHECK(paths("GET /a HTTP/1.1\r\nX-A: b\tc\xff \r\nX-B:\r\n"
+                        "\r\n", lazy) == "/a ");
+
+                /* a header line starts with a name */
+                for (auto line : {"/: evil", "\"x\": y z", "::", "=:",
+                                ": a", ";x: y"})
+                        CHECK(paths(("GET /a HTTP/1.1\r\n" +
+                                std::string(line) + "\r\n\r\n").c_str(),
+                                lazy) == "bad header");
+        }
+}
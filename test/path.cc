@@ -0,0 +1,63 @@
+#include "check.h"
+#include "path.h"
+#include <cstring>
+#include <string>
+
+/* the canonical path, or "!" if the target is refused */
+static std::string canon(const char *target)
+{
+        astring out;
+        size_t q;
+        if (!normalize_path(span{target, strlen(target)}, out, &q))
+                return "!";
+        return std::string(out.data(), out.size());
+}
+
+static bool authority(const char *target)
+{
+        return authority_form(span{target, strlen(target)});
+}
+
+/* the target a request's line carried, or "!" if it was refused */
+static std::string target(const char *line)
+{
+        std::string in {line};
+        in += " HTTP/1.1\r\nHost: x\r\n\r\n";
+        std::string s {"!"};
+        parse(in.c_str(), false, [&](const request& req) {
+                s = req.verb == METHOD_CONNECT ? req.text(req.target).str() :
+                        std::string(req.path.data(), req.path.size());
+        });
+        return s;
+}
+
+void test_path(void)
+{
+        CHECK(canon("/a//b/./c/../d?x=1") == "/a/b/d");
+        CHECK(canon("/../../a") == "/a");
+        CHECK(canon("/a%2Fb/%41") == "/a%2Fb/A");
+        CHECK(canon("http://host:80/a/b") == "/a/b");
+        CHECK(canon("http://host") == "/");
+        CHECK(canon("*") == "*");
+        CHECK(canon("/a%00") == "!");
+        CHECK(canon("/a%4") == "!");
+        CHECK(canon("host:443") == "!");
+
+        CHECK(authority("example.com:443"));
+        CHECK(authority("10.0.0.1:8080"));
+        CHECK(authority("[::1]:8080"));
+        CHECK(!authority("example.com"));
+        CHECK(!authority("example.com:"));
+        CHECK(!authority(":443"));
+        CHECK(!authority("example.com:99999"));
+        CHECK(!authority("user@example.com:443"));
+        CHECK(!authority("/a:443"));
+        CHECK(!authority("[::1:443"));
+
+        /* authority-form is CONNECT's, and CONNECT takes nothing else */
+        CHECK(target("CONNECT example.com:443") == "example.com:443");
+        CHECK(target("GET example.com:443") == "!");
+        CHECK(target("CONNECT /a") == "!");
+        CHECK(target("CONNECT http://example.com/") == "!");
+        CHECK(target("GET /a/../b") == "/b");
+}
@@ -0,0 +1,68 @@
+#include "check.h"
+#include "rewrite.h"
+#include <string>
+
+static std::string join(rewriter& w)
+{
+        std::string s;
+        for (const auto& v : w.iov())
+                s.append(static_cast<const char *>(v.iov_base), v.iov_len);
+        return s;
+}
+
+void test_rewrite(void)
+{
+        static const char IN[] {
+                "GET /a HTTP/1.1\r\n"
+                "Host: x\r\n"
+                "Connection: keep-alive\r\n"
+                "X-A: 1\r\n"
+                "Accept: */*\r\n"
+                "x-a: 2\r\n"
+                "Foo:  bar \r\n"
+                "\r\n"};
+        static const char OUT[] {
+                "GET /a HTTP/1.1\r\n"
+                "Host: x\r\n"
+                "Connection: close\r\n"
+                "Accept: */*\r\n"
+                "Foo:  bar \r\n"
+                "X-Forwarded-For: 5.6.7.8\r\n"
+                "Via: 1.1 proxy\r\n"
+                "\r\n"};
+
+        for (auto lazy : {false, true}) {
+                auto calls = 0;
+                auto state = parse(IN, lazy, [&](const request& req) {
+                        calls++;
+                        /* left alone, the head goes out as it came */
+                        rewriter same {req};
+                        CHECK(same.iov().size() == 1);
+                        CHECK(join(same) == std::string(req.raw, req.head));
+
+                        rewriter w {req};
+                        CHECK(w.set("Connection", "close"));
+                        CHECK(w.set("X-Forwarded-For", "1.2.3.4"));
+                        CHECK(w.set("X-Forwarded-For", "5.6.7.8"));
+                        w.drop("x-a");
+                        CHECK(w.add("Via", "1.1 proxy"));
+                        CHECK(join(w) == OUT);
+                        CHECK(w.size() == sizeof(OUT) - 1);
+
+                        /* nothing can be smuggled in */
+                        CHECK(!w.set("X-B", "a\r\nb"));
+                        CHECK(!w.add("Bad Name", "x"));
+                        CHECK(!w.add("X-C", std::string("a\0b", 3)));
+                        CHECK(!w.add("X-D", "a\x01"));
+                        CHECK(!w.set("X-E", "\x7f"));
+                        CHECK(!w.add("X-F", "a\nb"));
+                        CHECK(join(w) == OUT);
+
+                        /* as the parser does, it takes HTAB and high bytes */
+                        rewriter t {req};
+                        CHECK(t.add("X-G", "a\tb\xc3\xa9"));
+                });
+                CHECK(state == PARSE_NEED_MORE);
+                CHECK(calls == 1);
+        }
+}
@@ -0,0 +1,71 @@
+#include "check.h"
+#include "router.h"
+#include <cstring>
+#include <string>
+
+static const char *const PATTERNS[] {
+        "/",
+        "/users",
+        "/users/new",
+        "/users/:id",
+        "/users/:id/posts",
+        "/users/:id/posts/:post",
+        "/static/*file",
+        "/api/v1/items",
+        "/api/:ver/things",
+        "/a/*rest",
+        "/a/b/c",
+};
+
+/*
+ * the pattern path matched and its parameters after it, space
+ * separated, or "-" for no match
+ */
+static std::string route(const router& r, const char *path)
+{
+        route_match m;
+        if (!r.match(span{path, strlen(path)}, &m))
+                return "-";
+        std::string s {PATTERNS[m.id]};
+        for (size_t i = 0; i < m.nparams; i++)
+                s += " " + m.params[i].str();
+        return s;
+}
+
+void test_router(void)
+{
+        router r;
+        for (size_t i = 0; i < sizeof(PATTERNS) / sizeof(PATTERNS[0]); i++)
+                CHECK(r.add(PATTERNS[i], static_cast<int>(i)));
+
+        /* malformed, duplicate or differently named at the same place */
+        CHECK(!r.add("/users/:uid", 99));
+        CHECK(!r.add("/x/*a/b", 99));
+        CHECK(!r.add("users", 99));
+        CHECK(!r.add("/users", 99));
+        CHECK(!r.add("/z/:", 99));
+        CHECK(!r.add("/p/:a/:b/:c/:d/:e/:f/:g/:h/:i", 99));
+        r.compile();
+
+        /* static text wins over a parameter, a parameter over a wildcard */
+        CHECK(route(r, "/") == "/");
+        CHECK(route(r, "/users") == "/users");
+        CHECK(route(r, "/users/new") == "/users/new");
+        CHECK(route(r, "/users/newest") == "/users/:id newest");
+        CHECK(route(r, "/users/42") == "/users/:id 42");
+        CHECK(route(r, "/users/42/posts/7") == "/users/:id/posts/:post 42 7");
+        CHECK(route(r, "/static/css/a.css") == "/static/*file css/a.css");
+        CHECK(route(r, "/static/") == "/static/*file ");
+        CHECK(route(r, "/api/v1/items") == "/api/v1/items");
+
+        /* a static branch that dead-ends backs up to the others */
+        CHECK(route(r, "/users/new/posts") == "/users/:id/posts new");
+        CHECK(route(r, "/api/v1/things") == "/api/:ver/things v1");
+        CHECK(route(r, "/a/b/c") == "/a/b/c");
+        CHECK(route(r, "/a/b/d") == "/a/*rest b/d");
+        CHECK(route(r, "/a/b/c/d") == "/a/*rest b/c/d");
+
+        CHECK(route(r, "/users/42/posts/7/x") == "-");
+        CHECK(route(r, "/users/") == "-");
+        CHECK(route(r, "/nope") == "-");
+}
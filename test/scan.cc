@@ -0,0 +1,68 @@
+#include "check.h"
+#include "scan.h"
+#include <cstdint>
+
+/*
+ * bytes the scanners treat differently: word bytes, the extra word
+ * bytes and delimiters the lexer asks about, controls with and
+ * without HTAB and DEL, and bytes with the high bit set, which are
+ * negative as a char and easy to get wrong in a signed compare.
+ */
+static const char pool[] = "aZz09-*:,;\"= /\r\n\t\x01\x1f\x7f\x80\xc3\xff";
+
+static uint32_t rnd(uint32_t& s)
+{
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        return s;
+}
+
+struct answers {
+        size_t byte, word, ctl;
+};
+
+static answers scan_all(const char *p, size_t n, char c)
+{
+        return answers{scan_byte(p, n, c), scan_word(p, n, '-', '*'),
+                scan_ctl(p, n)};
+}
+
+/*
+ * every instruction set the cpu has must give the scalar answers on
+ * random buffers of every length up to a few vectors, starting at
+ * every alignment.
+ */
+void test_scan(void)
+{
+        static const int ROUNDS {200000};
+        char buf[128 + 32];
+        uint32_t seed {0x9e3779b9};
+        auto was = scan_isa();
+
+        for (int r = 0; r < ROUNDS; r++) {
+                auto off = rnd(seed) % 32;
+                auto n = rnd(seed) % 128;
+                /* most buffers are sparse, so scans get past a vector */
+                auto dense = rnd(seed) % 4 == 0;
+                for (size_t i = 0; i < n; i++) {
+                        auto k = rnd(seed) % (sizeof(pool) - 1);
+                        if (!dense && rnd(seed) % 32 != 0)
+                                k %= 6;
+                        buf[off + i] = pool[k];
+                }
+                auto c = pool[rnd(seed) % (sizeof(pool) - 1)];
+
+                scan_select(SCAN_SCALAR);
+                auto want = scan_all(buf + off, n, c);
+                for (int isa : {SCAN_SSE2, SCAN_AVX2}) {
+                        if (scan_select(isa) != isa)
+                                break;
+                        auto got = scan_all(buf + off, n, c);
+                        CHECK(got.byte == want.byte);
+                        CHECK(got.word == want.word);
+                        CHECK(got.ctl == want.ctl);
+                }
+        }
+        scan_select(was);
+}
@@ -1,58 +1,12 @@
 #include "token.h"
 
-token::token(int type, const std::string& lex)
-        : _lex {lex},
-        _type {type}
+const char *token_name(int type)
 {
-        switch (_type) {
-        case TOK_EOF:
-        case TOK_EOL:
-        case TOK_CONTENT_LENGTH:
-        case TOK_GET:
-        case TOK_PATH:
-        case TOK_HTTP:
-        case TOK_NUM:
-        case TOK_SLASH:
-        case TOK_WORD:
-        case TOK_COLON:
-        case TOK_DOT:
-        case TOK_EQ:
-        case TOK_COMMA:
-        case TOK_SEMI:
-        case TOK_ACCEPT:
-        case TOK_ACCEPT_CHARSET:
-        case TOK_ACCEPT_ENCODING:
-        case TOK_ACCEPT_LANGUAGE:
-        case TOK_AUTHORIZATION:
-        case TOK_CACHE_CONTROL:
-        case TOK_STR:
-        case TOK_CONNECTION:
-        case TOK_CONTENT_ENCODING:
-        case TOK_CONTENT_LANGUAGE:
-        case TOK_CONTENT_MD5:
-                break;
-        default:
-                usage("bad token type: %d", _type);
-        }
-}
-
-int token::type(void) const
-{
-        return _type;
-}
-
-const std::string& token::lex(void) const
-{
-        return _lex;
-}
-
-const std::string& token::name(void) const
-{
-        static std::array<std::string,TOK_COUNT> names {
+        static const char *names[] {
                 "TOK_EOF",
                 "TOK_EOL",
                 "TOK_CONTENT_LENGTH",
-                "TOK_GET",
+                "TOK_METHOD",
                 "TOK_PATH",
                 "TOK_HTTP",
                 "TOK_NUM",
@@ -74,7 +28,18 @@ const std::string& token::name(void) const
                 "TOK_CONTENT_ENCODING",
                 "TOK_CONTENT_LANGUAGE",
                 "TOK_CONTENT_MD5",
+                "TOK_TRANSFER_ENCODING",
+                "TOK_FIELD",
         };
+        static_assert(sizeof(names) / sizeof(names[0]) == TOK_COUNT,
+                "a name for every token");
 
-        return names.at(_type);
+        if (type < 0 || type >= TOK_COUNT)
+                return "TOK_?";
+        return names[type];
+}
+
+const char *token::name(void) const
+{
+        return token_name(_type);
 }
@@ -1,15 +1,14 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
-#include "error.h"
-#include <array>
-#include <string>
+#include <cstddef>
+#include <cstdint>
 
 enum {
         TOK_EOF,
         TOK_EOL,
         TOK_CONTENT_LENGTH,
-        TOK_GET,
+        TOK_METHOD,
         TOK_PATH,
         TOK_HTTP,
         TOK_NUM,
@@ -31,18 +30,50 @@ enum {
         TOK_CONTENT_ENCODING,
         TOK_CONTENT_LANGUAGE,
         TOK_CONTENT_MD5,
+        TOK_TRANSFER_ENCODING,
+        TOK_FIELD,
         TOK_COUNT,
 };
 
+/*
+ * a token does not own its lexeme: it is the offset and length of
+ * the lexeme in the buffer being lexed. it is plain data, twelve
+ * bytes, so arrays of them are cheap to fill and to walk; buffers
+ * are limited to 4 GiB as a result.
+ */
 class token {
 private:
-        std::string _lex {};
-        int _type {TOK_EOF};
+        uint32_t _off;
+        uint32_t _len;
+        uint8_t _type;
 public:
-        token(int type = TOK_EOF, const std::string& lex = "");
-        int type(void) const;
-        const std::string& lex(void) const;
-        const std::string& name(void) const;
+        token(void) = default;
+
+        token(int type, size_t off = 0, size_t len = 0)
+                : _off {static_cast<uint32_t>(off)},
+                _len {static_cast<uint32_t>(len)},
+                _type {static_cast<uint8_t>(type)}
+        {
+        }
+
+        int type(void) const
+        {
+                return _type;
+        }
+
+        size_t off(void) const
+        {
+                return _off;
+        }
+
+        size_t len(void) const
+        {
+                return _len;
+        }
+
+        const char *name(void) const;
 };
 
+const char *token_name(int type);
+
 #endif